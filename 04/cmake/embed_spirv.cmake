@@ -0,0 +1,36 @@
+# 把 SPIR-V 文件转换成 constexpr 数组, 由 CMakeLists.txt 在构建时以 cmake -P 调用
+# 参数: INPUT (spv 文件)  OUTPUT (生成的头文件)  NAME (常量名)  SOURCE (GLSL 文件名, 用于日志)
+
+file(READ "${INPUT}" HEX HEX)
+string(LENGTH "${HEX}" HEX_LENGTH)
+math(EXPR HEX_REMAINDER "${HEX_LENGTH} % 8")
+if (HEX_LENGTH LESS 40 OR NOT HEX_REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a valid SPIR-V module")
+endif()
+
+# 魔数 0x07230203 按小端存储
+string(SUBSTRING "${HEX}" 0 8 MAGIC)
+if (NOT MAGIC STREQUAL "03022307")
+    message(FATAL_ERROR "${INPUT} has a wrong SPIR-V magic number")
+endif()
+
+# 每 4 字节转换成一个 uint32_t, 每行 8 个
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " WORDS "${HEX}")
+# cmake 的正则不支持 {n}, 8 个字直接展开
+set(WORD "0x........u, ")
+string(REGEX REPLACE "(${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD})" "\\1\n    " WORDS "${WORDS}")
+string(REPLACE " \n" "\n" WORDS "${WORDS}")
+string(STRIP "${WORDS}" WORDS)
+
+file(WRITE "${OUTPUT}"
+"// 由 cmake/embed_spirv.cmake 从 ${SOURCE} 生成, 不要修改
+#pragma once
+
+#include \"gpu_embedded_shader.h\"
+
+inline constexpr uint32_t kEmbedded${NAME}Code[] = {
+    ${WORDS}
+};
+
+inline constexpr GpuEmbeddedShader kEmbedded${NAME} = GpuMakeEmbeddedShader(kEmbedded${NAME}Code, \"${SOURCE}\");
+")
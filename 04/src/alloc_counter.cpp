@@ -0,0 +1,111 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef VULKAN_APP_ALLOC_CHECK
+namespace {
+std::atomic<uint64_t> g_alloc_count = 0;
+
+void* CountedAlloc(size_t size, size_t alignment)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+    {
+        size = 1;
+    }
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    if (alignment <= alignof(std::max_align_t))
+    {
+        return malloc(size);
+    }
+    void* memory = nullptr;
+    return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+}
+
+void CountedFree(void* memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+}
+
+void* operator new(size_t size)
+{
+    void* memory = CountedAlloc(size, alignof(std::max_align_t));
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    void* memory = CountedAlloc(size, static_cast<size_t>(alignment));
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept { CountedFree(memory); }
+void operator delete[](void* memory) noexcept { CountedFree(memory); }
+void operator delete(void* memory, size_t) noexcept { CountedFree(memory); }
+void operator delete[](void* memory, size_t) noexcept { CountedFree(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { CountedFree(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { CountedFree(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { CountedFree(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { CountedFree(memory); }
+#endif
+
+namespace AllocCounter {
+
+bool IsEnabled()
+{
+#ifdef VULKAN_APP_ALLOC_CHECK
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t Count()
+{
+#ifdef VULKAN_APP_ALLOC_CHECK
+    return g_alloc_count.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief 全局 operator new 计数
+ * 只有定义了 VULKAN_APP_ALLOC_CHECK (CMake 选项 VULKAN_APP_ALLOC_CHECK) 时才替换全局 operator new,
+ * 用来确认稳定状态下 DrawFrame 和命令录制不做堆分配
+ */
+namespace AllocCounter {
+
+/**
+ * @brief 是否编译了计数钩子
+ */
+bool IsEnabled();
+
+/**
+ * @brief 进程启动以来 operator new 的调用次数, 未开启时恒为 0
+ */
+uint64_t Count();
+
+}
@@ -1,70 +1,427 @@
-#include "app.h"
-
-#include <fmt/format.h>
-
-#include "gpu_program.h"
-
-Application::~Application()
-{
-    if (window_)
-    {
-        SDL_DestroyWindow(window_);
-        window_ = nullptr;
-    }
-
-    SDL_Quit();
-}
-
-Application* Application::GetInstance()
-{
-    static Application obj;
-    return &obj;
-}
-
-bool Application::Init()
-{
-    SDL_Init(SDL_INIT_EVERYTHING);
-    return true;
-}
-
-int32_t Application::Exec()
-{
-    int32_t window_flag = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN;
-
-    SDL_Window* tmp_window = SDL_CreateWindow(title_.c_str(),
-        SDL_WINDOWPOS_CENTERED,
-        SDL_WINDOWPOS_CENTERED,
-        800, 600,
-        window_flag);
-    if (tmp_window == nullptr)
-    {
-        fmt::print("SDL_CreateWindows call fail! error: {}\n", SDL_GetError());
-        return -1;
-    }
-
-    window_ = tmp_window;
-
-    if (!GpuProgram::GetInstance()->Init(window_))
-    {
-        return false;
-    }
-
-    while (true)
-    {
-        SDL_Event event;
-        int32_t ret = SDL_PollEvent(&event);
-
-        if (ret != 0) {
-            if (event.type == SDL_QUIT)
-            {
-                break;
-            }
-        }
-        else {
-            SDL_Delay(2);
-        }
-
-        GpuProgram::GetInstance()->DrawFrame();
-    }
-    GpuProgram::GetInstance()->Uninit();
+#include "app.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <string_view>
+#include <thread>
+#include <fmt/format.h>
+
+#include "alloc_counter.h"
+#include "gpu_host_allocator.h"
+#include "gpu_program.h"
+
+namespace {
+bool ParseUint(std::string_view text, uint32_t& value)
+{
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+/**
+ * @brief 驱动在对象/缓存/设备/实例作用域累计的主机分配次数, COMMAND 作用域走 arena 不计
+ */
+uint64_t DriverAllocationCount()
+{
+    uint64_t count = 0;
+    for (VkSystemAllocationScope scope : { VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, VK_SYSTEM_ALLOCATION_SCOPE_CACHE,
+        VK_SYSTEM_ALLOCATION_SCOPE_DEVICE, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE })
+    {
+        count += GpuHostAllocator::GetInstance()->GetStats(scope).total_count;
+    }
+    return count;
+}
+
+bool ParsePresentProfile(std::string_view text, PresentProfile& profile)
+{
+    if (text == "balanced")
+    {
+        profile = PresentProfile::kBalanced;
+    }
+    else if (text == "low-latency") {
+        profile = PresentProfile::kLowLatency;
+    }
+    else if (text == "power-saving") {
+        profile = PresentProfile::kPowerSaving;
+    }
+    else if (text == "max-throughput") {
+        profile = PresentProfile::kMaxThroughput;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief F1-F4 依次对应四种呈现策略
+ */
+bool PresentProfileForKey(SDL_Keycode key, PresentProfile& profile)
+{
+    switch (key)
+    {
+    case SDLK_F1: profile = PresentProfile::kBalanced; return true;
+    case SDLK_F2: profile = PresentProfile::kLowLatency; return true;
+    case SDLK_F3: profile = PresentProfile::kPowerSaving; return true;
+    case SDLK_F4: profile = PresentProfile::kMaxThroughput; return true;
+    default: return false;
+    }
+}
+}
+
+Application::~Application()
+{
+    if (render_thread_.joinable())
+    {
+        _PostRenderEvent(RenderEvent{ RenderEventType::kQuit });
+        render_thread_.join();
+    }
+
+    if (window_)
+    {
+        SDL_DestroyWindow(window_);
+        window_ = nullptr;
+    }
+
+    SDL_Quit();
+}
+
+Application* Application::GetInstance()
+{
+    static Application obj;
+    return &obj;
+}
+
+bool Application::Init(int argc, char* argv[])
+{
+    _ParseArgs(argc, argv);
+
+    // 无窗口模式下机器可能没有显示设备, 不初始化视频子系统
+    SDL_Init(gpu_config_.headless ? SDL_INIT_TIMER : SDL_INIT_EVERYTHING);
+    return true;
+}
+
+int32_t Application::Exec()
+{
+    if (gpu_config_.headless)
+    {
+        return _ExecHeadless();
+    }
+
+    int32_t window_flag = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN;
+
+    SDL_Window* tmp_window = SDL_CreateWindow(title_.c_str(),
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        800, 600,
+        window_flag);
+    if (tmp_window == nullptr)
+    {
+        fmt::print("SDL_CreateWindows call fail! error: {}\n", SDL_GetError());
+        return -1;
+    }
+
+    window_ = tmp_window;
+
+    if (!GpuProgram::GetInstance()->Init(window_, gpu_config_))
+    {
+        return false;
+    }
+
+    // 渲染线程独占 VkQueue, 主线程只负责 SDL 事件, GPU 阻塞不再影响输入响应
+    render_thread_ = std::thread(&Application::_RenderLoop, this);
+    _UpdateTargetFps();
+
+    SDL_Event event;
+    while (SDL_WaitEvent(&event) != 0)
+    {
+        if (!_HandleEvent(event))
+        {
+            break;
+        }
+    }
+
+    _PostRenderEvent(RenderEvent{ RenderEventType::kQuit });
+    render_thread_.join();
+    GpuProgram::GetInstance()->Uninit();
+    return 0;
+}
+
+bool Application::_HandleEvent(const SDL_Event& event)
+{
+    if (event.type == SDL_QUIT)
+    {
+        return false;
+    }
+    else if (event.type == SDL_WINDOWEVENT) {
+        switch (event.window.event)
+        {
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+            _PostRenderEvent(RenderEvent{ RenderEventType::kResize, event });
+            break;
+        case SDL_WINDOWEVENT_MINIMIZED:
+            _PostRenderEvent(RenderEvent{ RenderEventType::kMinimized, event });
+            break;
+        case SDL_WINDOWEVENT_RESTORED:
+            _PostRenderEvent(RenderEvent{ RenderEventType::kRestored, event });
+            break;
+        case SDL_WINDOWEVENT_MOVED:
+            // 窗口可能被移到刷新率不同的显示器上
+            _UpdateTargetFps();
+            break;
+        default:
+            break;
+        }
+    }
+    else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+        RenderEvent render_event{ RenderEventType::kInput, event };
+        if (event.type == SDL_KEYDOWN && event.key.repeat == 0 && PresentProfileForKey(event.key.keysym.sym, render_event.present_profile))
+        {
+            render_event.type = RenderEventType::kPresentProfile;
+        }
+        _PostRenderEvent(render_event);
+    }
+    return true;
+}
+
+void Application::_UpdateTargetFps()
+{
+    double fps = 60.0;
+    SDL_DisplayMode mode;
+    if (target_fps_.has_value())
+    {
+        fps = *target_fps_;
+    }
+    else if (SDL_GetWindowDisplayMode(window_, &mode) == 0 && mode.refresh_rate > 0) {
+        fps = mode.refresh_rate;
+    }
+
+    if (fps != posted_fps_)
+    {
+        posted_fps_ = fps;
+        RenderEvent render_event{ RenderEventType::kTargetFps };
+        render_event.fps = fps;
+        _PostRenderEvent(render_event);
+    }
+}
+
+void Application::_PostRenderEvent(const RenderEvent& event)
+{
+    // 队列满说明渲染线程落后, 输入事件可以丢弃, 窗口事件必须送达
+    while (!render_events_.TryPush(event))
+    {
+        if (event.type == RenderEventType::kInput)
+        {
+            return;
+        }
+        std::this_thread::yield();
+    }
+    render_event_seq_.fetch_add(1, std::memory_order_release);
+    render_event_seq_.notify_one();
+}
+
+void Application::_RenderLoop()
+{
+    FramePacer frame_pacer;
+    bool minimized = false;
+    bool running = true;
+    while (running)
+    {
+        uint32_t seq = render_event_seq_.load(std::memory_order_acquire);
+
+        RenderEvent event;
+        while (running && render_events_.TryPop(event))
+        {
+            switch (event.type)
+            {
+            case RenderEventType::kQuit:
+                running = false;
+                break;
+            case RenderEventType::kResize:
+                GpuProgram::GetInstance()->OnResize();
+                break;
+            case RenderEventType::kMinimized:
+                minimized = true;
+                break;
+            case RenderEventType::kRestored:
+                minimized = false;
+                frame_pacer.Reset();
+                break;
+            case RenderEventType::kTargetFps:
+                frame_pacer.SetTargetFps(event.fps);
+                break;
+            case RenderEventType::kPresentProfile:
+                // 呈现策略和交换链都归渲染线程所有, 在这里切换
+                GpuProgram::GetInstance()->SetPresentProfile(event.present_profile);
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (!running)
+        {
+            break;
+        }
+
+        // 最小化时不渲染, 阻塞到主线程投递新事件
+        if (minimized)
+        {
+            render_event_seq_.wait(seq, std::memory_order_acquire);
+            continue;
+        }
+
+        GpuProgram::GetInstance()->DrawFrame();
+        frame_pacer.WaitNextFrame();
+    }
+}
+
+void Application::_ParseArgs(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        bool valid = true;
+        if (arg == "--headless")
+        {
+            gpu_config_.headless = true;
+        }
+        else if (arg == "--alloc-check")
+        {
+            gpu_config_.headless = true;
+            alloc_check_ = true;
+        }
+        else if (arg == "--upload-check")
+        {
+            gpu_config_.headless = true;
+            upload_check_ = true;
+        }
+        else if (arg == "--hot-reload")
+        {
+            gpu_config_.shader_hot_reload = true;
+        }
+        else if (arg == "--render-pass")
+        {
+            gpu_config_.dynamic_rendering = false;
+        }
+        else if (arg == "--system-allocator")
+        {
+            gpu_config_.host_allocator = false;
+        }
+        else if (arg == "--validation")
+        {
+            gpu_config_.validation = true;
+        }
+        else if (arg.starts_with("--frames="))
+        {
+            valid = ParseUint(arg.substr(9), headless_frames_);
+        }
+        else if (arg.starts_with("--frames-in-flight="))
+        {
+            valid = ParseUint(arg.substr(19), gpu_config_.frames_in_flight);
+        }
+        else if (arg.starts_with("--pipeline-cache="))
+        {
+            gpu_config_.pipeline_cache_path = std::string(arg.substr(17));
+        }
+        else if (arg.starts_with("--fps="))
+        {
+            uint32_t fps = 0;
+            valid = ParseUint(arg.substr(6), fps);
+            if (valid)
+            {
+                target_fps_ = fps;
+            }
+        }
+        else if (arg.starts_with("--present="))
+        {
+            valid = ParsePresentProfile(arg.substr(10), gpu_config_.present_profile);
+        }
+        else {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            fmt::print("ignore invalid argument: {}\n", arg);
+        }
+    }
+}
+
+int32_t Application::_ExecHeadless()
+{
+    if (!GpuProgram::GetInstance()->Init(nullptr, gpu_config_))
+    {
+        GpuProgram::GetInstance()->Uninit();
+        return -1;
+    }
+
+    if (upload_check_ && !GpuProgram::GetInstance()->CheckUploads())
+    {
+        GpuProgram::GetInstance()->Uninit();
+        return -1;
+    }
+
+    // 编译线程的分配也会被计数, 先等管线编译完
+    if (alloc_check_)
+    {
+        GpuProgram::GetInstance()->WaitPipelines();
+    }
+
+    // 预热期间帧上下文和离屏图片各轮转几遍, 之后 DrawFrame 不应再有堆分配
+    uint32_t warmup_frames = std::min(headless_frames_, kAllocCheckWarmupFrames);
+    uint64_t heap_allocs = 0;
+    uint64_t driver_allocs = 0;
+
+    // 帧率只统计预热之后的稳定帧, 帧数不够时统计全部
+    uint32_t timed_begin = headless_frames_ > warmup_frames ? warmup_frames : 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < headless_frames_; i++)
+    {
+        if (i == timed_begin)
+        {
+            begin = std::chrono::steady_clock::now();
+        }
+        if (alloc_check_ && i == warmup_frames)
+        {
+            heap_allocs = AllocCounter::Count();
+            driver_allocs = DriverAllocationCount();
+        }
+        GpuProgram::GetInstance()->DrawFrame();
+    }
+    // 在 Uninit 之前结束计时, 不包含等待设备空闲和写回管线缓存
+    auto end = std::chrono::steady_clock::now();
+    if (alloc_check_)
+    {
+        heap_allocs = AllocCounter::Count() - heap_allocs;
+        driver_allocs = DriverAllocationCount() - driver_allocs;
+    }
+    GpuProgram::GetInstance()->Uninit();
+
+    uint32_t timed_frames = headless_frames_ - timed_begin;
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    fmt::print("headless: {} frames in {:.3f}s, {:.1f} fps ({} warm-up frames excluded)\n", timed_frames, seconds, 
+        seconds > 0.0 ? timed_frames / seconds : 0.0, timed_begin);
+
+    if (alloc_check_)
+    {
+        if (!AllocCounter::IsEnabled())
+        {
+            // 计数恒为 0, 不能当作通过
+            fmt::print("alloc check: operator new hook not compiled, configure with -DVULKAN_APP_ALLOC_CHECK=ON\n");
+            return -1;
+        }
+        if (headless_frames_ <= warmup_frames)
+        {
+            fmt::print("alloc check: need more than {} frames\n", warmup_frames);
+            return -1;
+        }
+        fmt::print("alloc check: {} heap allocations, {} driver object allocations in {} steady frames\n",
+            heap_allocs, driver_allocs, headless_frames_ - warmup_frames);
+        if (heap_allocs != 0 || driver_allocs != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
 }
\ No newline at end of file
@@ -1,22 +1,94 @@
-#pragma once
-
-#include <memory>
-#include <string>
-#define SDL_MAIN_HANDLED
-#include <SDL2/SDL.h>
-
-class Application
-{
-public:
-    static Application* GetInstance();
-    bool Init();
-    int32_t Exec();
-
-private:
-    Application() = default;
-    ~Application();
-
-private:
-    SDL_Window* window_ = nullptr;
-    std::string title_ = "hello vulkan";
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+#include "gpu_define.h"
+#include "frame_pacer.h"
+#include "spsc_queue.h"
+
+/**
+ * @brief 主线程投递给渲染线程的事件
+ */
+enum class RenderEventType
+{
+    kNone,
+    kQuit,
+    kResize,
+    kMinimized,
+    kRestored,
+    kTargetFps,
+    kPresentProfile,
+    kInput,
+};
+
+struct RenderEvent
+{
+    RenderEventType type = RenderEventType::kNone;
+    SDL_Event sdl_event{};  ///< 原始 SDL 事件
+    double fps = 0.0;       ///< kTargetFps 使用
+    PresentProfile present_profile = PresentProfile::kBalanced; ///< kPresentProfile 使用
+};
+
+class Application
+{
+public:
+    static Application* GetInstance();
+
+    /**
+     * @brief 初始化
+     * 支持的参数: --headless  --frames=N (无窗口模式渲染帧数)  --frames-in-flight=N
+     *            --present=balanced|low-latency|power-saving|max-throughput
+     *            --fps=N (目标帧率, 0 表示不限帧, 默认跟随显示器刷新率)
+     *            --pipeline-cache=PATH (管线缓存文件, 为空时不写磁盘)
+     *            --hot-reload (监视 shader 目录, 修改后在后台重新编译管线)
+     *            --render-pass (不使用动态渲染, 走渲染通道和帧缓冲)
+     *            --system-allocator (vulkan 主机内存使用驱动默认分配, 不统计)
+     *            --validation (开启 vulkan 校验层)
+     *            --alloc-check (无窗口运行, 预热后仍有堆分配或未编译计数钩子时返回非 0)
+     *            --upload-check (无窗口运行, 上传数据回读不一致时返回非 0)
+     * 运行时按 F1-F4 切换呈现策略: balanced, low-latency, power-saving, max-throughput
+     */
+    bool Init(int argc = 0, char* argv[] = nullptr);
+    int32_t Exec();
+
+private:
+    Application() = default;
+    ~Application();
+
+    void _ParseArgs(int argc, char* argv[]);
+    int32_t _ExecHeadless();
+
+    /**
+     * @brief 主线程处理单个事件, 返回 false 表示退出
+     */
+    bool _HandleEvent(const SDL_Event& event);
+    void _UpdateTargetFps();
+    void _PostRenderEvent(const RenderEvent& event);
+
+    /**
+     * @brief 渲染线程入口, 负责帧节奏和 DrawFrame
+     */
+    void _RenderLoop();
+
+private:
+    SDL_Window* window_ = nullptr;
+    std::string title_ = "hello vulkan";
+
+    GpuConfig gpu_config_;
+    uint32_t headless_frames_ = 1000;   ///< 无窗口模式下渲染的帧数
+    bool alloc_check_ = false;          ///< 检查稳定状态下每帧是否有堆分配
+    static constexpr uint32_t kAllocCheckWarmupFrames = 32;
+    bool upload_check_ = false;         ///< 绘制前检查暂存环和上传引擎的数据是否正确
+
+    std::optional<uint32_t> target_fps_;    ///< 未指定时使用窗口所在显示器的刷新率
+    double posted_fps_ = -1.0;              ///< 最近一次投递给渲染线程的帧率
+
+    std::thread render_thread_;
+    SpscQueue<RenderEvent, 256> render_events_;
+    std::atomic<uint32_t> render_event_seq_ = 0;   ///< 每投递一个事件加一, 渲染线程空闲时在此等待
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "frame_pacer.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <cerrno>
+#include <ctime>
+#endif
+
+namespace {
+// 定时器唤醒有调度误差, 截止前这段时间改为让出时间片等待
+constexpr auto kSpinMargin = std::chrono::microseconds(500);
+}
+
+FramePacer::FramePacer()
+{
+#ifdef _WIN32
+    // Windows 10 1803 之后支持高精度定时器, 不支持时退回普通定时器
+    timer_ = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (timer_ == nullptr)
+    {
+        timer_ = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+#endif
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+    if (timer_)
+    {
+        CloseHandle(timer_);
+        timer_ = nullptr;
+    }
+#endif
+}
+
+void FramePacer::SetTargetFps(double fps)
+{
+    target_fps_ = fps > 0.0 ? fps : 0.0;
+    if (fps > 0.0)
+    {
+        interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+    }
+    else {
+        interval_ = Clock::duration::zero();
+    }
+    Reset();
+}
+
+void FramePacer::WaitNextFrame()
+{
+    if (interval_ == Clock::duration::zero())
+    {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (!started_)
+    {
+        started_ = true;
+        next_deadline_ = now + interval_;
+        return;
+    }
+
+    if (now < next_deadline_)
+    {
+        _SleepUntil(next_deadline_);
+        next_deadline_ += interval_;
+    }
+    else if (now - next_deadline_ < interval_) {
+        // 略有超时, 保持原有节奏
+        next_deadline_ += interval_;
+    }
+    else {
+        next_deadline_ = now + interval_;
+    }
+}
+
+void FramePacer::Reset()
+{
+    started_ = false;
+}
+
+void FramePacer::_SleepUntil(Clock::time_point deadline)
+{
+    Clock::time_point coarse_deadline = deadline - kSpinMargin;
+    Clock::time_point now = Clock::now();
+    if (now < coarse_deadline)
+    {
+#ifdef _WIN32
+        auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(coarse_deadline - now);
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -static_cast<LONGLONG>(wait.count() / 100);   // 负数表示相对时间, 单位 100ns
+        if (timer_ && SetWaitableTimer(timer_, &due_time, 0, nullptr, nullptr, FALSE))
+        {
+            WaitForSingleObject(timer_, INFINITE);
+        }
+        else {
+            std::this_thread::sleep_until(coarse_deadline);
+        }
+#else
+        auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(coarse_deadline - now);
+        timespec request;
+        clock_gettime(CLOCK_MONOTONIC, &request);
+        int64_t nsec = request.tv_nsec + wait.count();
+        request.tv_sec += static_cast<time_t>(nsec / 1000000000);
+        request.tv_nsec = static_cast<long>(nsec % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &request, nullptr) == EINTR)
+        {
+        }
+#endif
+    }
+
+    while (Clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief 帧节奏控制
+ * 按固定间隔 (目标帧率或显示器刷新率) 安排每帧的开始时间,
+ * 先用高精度定时器睡到截止时间前, 剩余的一小段再让出时间片等待, 避免固定 SDL_Delay 带来的抖动
+ */
+class FramePacer final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer();
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    /**
+     * @brief 设置目标帧率, 0 表示不限帧 (由呈现模式控制节奏)
+     */
+    void SetTargetFps(double fps);
+    double GetTargetFps() const { return target_fps_; }
+
+    /**
+     * @brief 等待到下一帧的开始时间
+     * 落后超过一帧时直接以当前时间重新对齐, 不连续补帧
+     */
+    void WaitNextFrame();
+
+    /**
+     * @brief 重置节奏, 用于窗口最小化恢复等长时间停顿之后
+     */
+    void Reset();
+
+private:
+    void _SleepUntil(Clock::time_point deadline);
+
+private:
+    double target_fps_ = 0.0;
+    Clock::duration interval_ = Clock::duration::zero();
+    Clock::time_point next_deadline_;
+    bool started_ = false;
+
+#ifdef _WIN32
+    void* timer_ = nullptr;     ///< 高精度可等待定时器
+#endif
+};
@@ -0,0 +1,659 @@
+#include "gpu_allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <fmt/format.h>
+#include "gpu_host_allocator.h"
+
+GpuAllocator::~GpuAllocator()
+{
+    UnInit();
+}
+
+bool GpuAllocator::Init(VkDevice device, const VkPhysicalDeviceProperties& properties,
+    const VkPhysicalDeviceMemoryProperties& memory_properties, VkDeviceSize block_size)
+{
+    vk_device_ = device;
+    vk_memory_properties_ = memory_properties;
+    buffer_image_granularity_ = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    max_allocation_count_ = properties.limits.maxMemoryAllocationCount;
+
+    block_size_ = std::bit_ceil(std::max(block_size, kMinBlockSize * 2));
+    max_order_ = static_cast<uint32_t>(std::countr_zero(block_size_ / kMinBlockSize));
+    pools_.clear();
+    pools_.resize(vk_memory_properties_.memoryTypeCount * 2);
+    device_allocation_count_ = 0;
+    for (auto& usage : heap_usage_)
+    {
+        usage = 0;
+    }
+    _BuildUsageTable();
+    return true;
+}
+
+void GpuAllocator::UnInit()
+{
+    if (vk_device_ == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for (auto& pool : pools_)
+    {
+        for (auto& block : pool)
+        {
+            if (block->used != 0)
+            {
+                fmt::print("gpu allocator: {} bytes still in use on memory type {}\n", block->used, block->memory_type);
+            }
+            _FreeDeviceMemory(block->vk_memory, block->mapped != nullptr, block->size, block->memory_type);
+        }
+    }
+    pools_.clear();
+    vk_device_ = VK_NULL_HANDLE;
+}
+
+bool GpuAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, GpuResourceTiling tiling, GpuAllocation& allocation)
+{
+    // 先试同时满足 preferred 的类型, 显存不足时退回只满足 required 的类型
+    std::vector<uint32_t> memory_types;
+    for (VkMemoryPropertyFlags flags : { required | preferred, required })
+    {
+        std::optional<uint32_t> memory_type = FindMemoryType(requirements.memoryTypeBits, flags, 0);
+        if (memory_type.has_value() && std::find(memory_types.begin(), memory_types.end(), *memory_type) == memory_types.end())
+        {
+            memory_types.push_back(*memory_type);
+        }
+    }
+    if (memory_types.empty())
+    {
+        fmt::print("gpu allocator: no memory type for bits {:#x}, flags {:#x}\n", requirements.memoryTypeBits, required);
+        return false;
+    }
+    return _Allocate(requirements, memory_types, tiling, allocation);
+}
+
+bool GpuAllocator::Allocate(const VkMemoryRequirements& requirements, GpuMemoryUsage usage, GpuResourceTiling tiling,
+    GpuAllocation& allocation)
+{
+    // 按优先顺序尝试, 前面的堆满了再往后退
+    std::vector<uint32_t> memory_types;
+    for (uint32_t memory_type : usage_types_[static_cast<size_t>(usage)])
+    {
+        if (requirements.memoryTypeBits & (1u << memory_type))
+        {
+            memory_types.push_back(memory_type);
+        }
+    }
+    if (memory_types.empty())
+    {
+        fmt::print("gpu allocator: no memory type for bits {:#x}, usage {}\n", requirements.memoryTypeBits, static_cast<int32_t>(usage));
+        return false;
+    }
+    return _Allocate(requirements, memory_types, tiling, allocation);
+}
+
+bool GpuAllocator::_Allocate(const VkMemoryRequirements& requirements, const std::vector<uint32_t>& memory_types,
+    GpuResourceTiling tiling, GpuAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    VkDeviceSize need = std::max({ requirements.size, requirements.alignment, kMinBlockSize });
+    need = std::bit_ceil(need);
+
+    for (size_t i = 0; i < memory_types.size(); i++)
+    {
+        uint32_t memory_type = memory_types[i];
+        bool check_budget = i + 1 < memory_types.size();
+        allocation = GpuAllocation{};
+        allocation.memory_type = memory_type;
+        allocation.property_flags = vk_memory_properties_.memoryTypes[memory_type].propertyFlags;
+
+        // 大资源单独申请, 避免一次占掉整块
+        if (need > block_size_ / 2)
+        {
+            void* mapped = nullptr;
+            if (!_AllocateDeviceMemory(requirements.size, memory_type, check_budget, allocation.vk_memory, mapped))
+            {
+                continue;
+            }
+            allocation.size = requirements.size;
+            allocation.mapped = mapped;
+            return true;
+        }
+
+        uint32_t order = static_cast<uint32_t>(std::countr_zero(need / kMinBlockSize));
+        uint32_t pool_index = _PoolIndex(memory_type, tiling);
+        auto& pool = pools_[pool_index];
+
+        Block* target = nullptr;
+        VkDeviceSize offset = 0;
+        for (auto& block : pool)
+        {
+            if (_AllocateFromBlock(*block, order, offset))
+            {
+                target = block.get();
+                break;
+            }
+        }
+        if (target == nullptr)
+        {
+            target = _CreateBlock(memory_type, pool_index, check_budget);
+            if (target == nullptr || !_AllocateFromBlock(*target, order, offset))
+            {
+                continue;
+            }
+        }
+
+        if (target->used == 0)
+        {
+            _UnregisterSpareBlock(*target);
+        }
+        target->used += need;
+        allocation.vk_memory = target->vk_memory;
+        allocation.offset = offset;
+        allocation.size = need;
+        allocation.mapped = target->mapped ? static_cast<uint8_t*>(target->mapped) + offset : nullptr;
+        allocation.block = target;
+        allocation.order = order;
+        return true;
+    }
+
+    allocation = GpuAllocation{};
+    return false;
+}
+
+void GpuAllocator::Free(GpuAllocation& allocation)
+{
+    if (!allocation.IsValid())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (allocation.block == nullptr)
+    {
+        _FreeDeviceMemory(allocation.vk_memory, allocation.mapped != nullptr, allocation.size, allocation.memory_type);
+        allocation = GpuAllocation{};
+        return;
+    }
+
+    Block* block = static_cast<Block*>(allocation.block);
+    _FreeToBlock(*block, allocation.offset, allocation.order);
+    block->used -= allocation.size;
+    allocation = GpuAllocation{};
+
+    // 空块归还驱动, 每个池保留一块避免反复申请. 保留的块登记到驻留管理, 超出预算时也会归还
+    auto& pool = pools_[block->pool];
+    if (block->used == 0 && pool.size() > 1)
+    {
+        _FreeDeviceMemory(block->vk_memory, block->mapped != nullptr, block->size, block->memory_type);
+        pool.erase(std::find_if(pool.begin(), pool.end(), [block](const auto& item) { return item.get() == block; }));
+    }
+    else if (block->used == 0) {
+        _RegisterSpareBlock(*block);
+    }
+}
+
+void GpuAllocator::SetSpareBlockCallbacks(std::function<uint64_t(uint32_t heap_index, VkDeviceSize size, std::function<void()> evict)> register_block,
+    std::function<void(uint64_t id)> unregister_block)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pool : pools_)
+    {
+        for (auto& block : pool)
+        {
+            _UnregisterSpareBlock(*block);
+        }
+    }
+    register_spare_block_ = std::move(register_block);
+    unregister_spare_block_ = std::move(unregister_block);
+}
+
+bool GpuAllocator::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, GpuBuffer& buffer)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult ret = vkCreateBuffer(vk_device_, &bufferInfo, GpuHostCallbacks(), &buffer.vk_buffer);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateBuffer return error: {}\n", ret);
+        return false;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(vk_device_, buffer.vk_buffer, &memRequirements);
+    if (!Allocate(memRequirements, required, preferred, GpuResourceTiling::kLinear, buffer.allocation))
+    {
+        DestroyBuffer(buffer);
+        return false;
+    }
+
+    ret = vkBindBufferMemory(vk_device_, buffer.vk_buffer, buffer.allocation.vk_memory, buffer.allocation.offset);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkBindBufferMemory return error: {}\n", ret);
+        DestroyBuffer(buffer);
+        return false;
+    }
+    return true;
+}
+
+bool GpuAllocator::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, GpuMemoryUsage memory_usage, GpuBuffer& buffer)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult ret = vkCreateBuffer(vk_device_, &bufferInfo, GpuHostCallbacks(), &buffer.vk_buffer);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateBuffer return error: {}\n", ret);
+        return false;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(vk_device_, buffer.vk_buffer, &memRequirements);
+    if (!Allocate(memRequirements, memory_usage, GpuResourceTiling::kLinear, buffer.allocation))
+    {
+        DestroyBuffer(buffer);
+        return false;
+    }
+
+    ret = vkBindBufferMemory(vk_device_, buffer.vk_buffer, buffer.allocation.vk_memory, buffer.allocation.offset);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkBindBufferMemory return error: {}\n", ret);
+        DestroyBuffer(buffer);
+        return false;
+    }
+    return true;
+}
+
+void GpuAllocator::DestroyBuffer(GpuBuffer& buffer)
+{
+    if (buffer.vk_buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(vk_device_, buffer.vk_buffer, GpuHostCallbacks());
+        buffer.vk_buffer = VK_NULL_HANDLE;
+    }
+    Free(buffer.allocation);
+}
+
+bool GpuAllocator::CreateImage(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, GpuImage& image)
+{
+    VkResult ret = vkCreateImage(vk_device_, &create_info, GpuHostCallbacks(), &image.vk_image);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateImage return error: {}\n", ret);
+        return false;
+    }
+
+    GpuResourceTiling tiling = create_info.tiling == VK_IMAGE_TILING_LINEAR ? GpuResourceTiling::kLinear : GpuResourceTiling::kOptimal;
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(vk_device_, image.vk_image, &memRequirements);
+    if (!Allocate(memRequirements, required, preferred, tiling, image.allocation))
+    {
+        DestroyImage(image);
+        return false;
+    }
+
+    ret = vkBindImageMemory(vk_device_, image.vk_image, image.allocation.vk_memory, image.allocation.offset);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkBindImageMemory return error: {}\n", ret);
+        DestroyImage(image);
+        return false;
+    }
+    return true;
+}
+
+bool GpuAllocator::CreateImage(const VkImageCreateInfo& create_info, GpuMemoryUsage memory_usage, GpuImage& image)
+{
+    VkResult ret = vkCreateImage(vk_device_, &create_info, GpuHostCallbacks(), &image.vk_image);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateImage return error: {}\n", ret);
+        return false;
+    }
+
+    GpuResourceTiling tiling = create_info.tiling == VK_IMAGE_TILING_LINEAR ? GpuResourceTiling::kLinear : GpuResourceTiling::kOptimal;
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(vk_device_, image.vk_image, &memRequirements);
+    if (!Allocate(memRequirements, memory_usage, tiling, image.allocation))
+    {
+        DestroyImage(image);
+        return false;
+    }
+
+    ret = vkBindImageMemory(vk_device_, image.vk_image, image.allocation.vk_memory, image.allocation.offset);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkBindImageMemory return error: {}\n", ret);
+        DestroyImage(image);
+        return false;
+    }
+    return true;
+}
+
+void GpuAllocator::DestroyImage(GpuImage& image)
+{
+    if (image.vk_image != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(vk_device_, image.vk_image, GpuHostCallbacks());
+        image.vk_image = VK_NULL_HANDLE;
+    }
+    Free(image.allocation);
+}
+
+std::optional<uint32_t> GpuAllocator::FindMemoryType(uint32_t type_bits, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred) const
+{
+    std::optional<uint32_t> fallback;
+    for (uint32_t i = 0; i < vk_memory_properties_.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = vk_memory_properties_.memoryTypes[i].propertyFlags;
+        if ((type_bits & (1u << i)) == 0 || (flags & required) != required)
+        {
+            continue;
+        }
+        if ((flags & preferred) == preferred)
+        {
+            return i;
+        }
+        if (!fallback.has_value())
+        {
+            fallback = i;
+        }
+    }
+    return fallback;
+}
+
+std::optional<uint32_t> GpuAllocator::FindMemoryType(uint32_t type_bits, GpuMemoryUsage usage) const
+{
+    for (uint32_t memory_type : usage_types_[static_cast<size_t>(usage)])
+    {
+        if (type_bits & (1u << memory_type))
+        {
+            return memory_type;
+        }
+    }
+    return {};
+}
+
+bool GpuAllocator::PreferDirectWrite(VkDeviceSize size) const
+{
+    if (unified_memory_ || resizable_bar_)
+    {
+        return true;
+    }
+
+    // 小 BAR 窗口或落在系统内存时 GPU 读取都走 PCIe, 只适合小块数据
+    return size <= kSmallBarDirectWriteLimit;
+}
+
+void GpuAllocator::_BuildUsageTable()
+{
+    constexpr VkMemoryPropertyFlags kDeviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    constexpr VkMemoryPropertyFlags kHostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    constexpr VkMemoryPropertyFlags kHostCoherent = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    constexpr VkMemoryPropertyFlags kHostCached = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    // 统一内存: 每个 DEVICE_LOCAL 类型都可以映射; ReBAR: 可映射的显存堆超过传统 256MB 窗口
+    unified_memory_ = true;
+    resizable_bar_ = false;
+    bool has_device_local = false;
+    for (uint32_t i = 0; i < vk_memory_properties_.memoryTypeCount; i++)
+    {
+        const VkMemoryType& type = vk_memory_properties_.memoryTypes[i];
+        if ((type.propertyFlags & kDeviceLocal) == 0)
+        {
+            continue;
+        }
+        has_device_local = true;
+        if ((type.propertyFlags & kHostVisible) == 0)
+        {
+            unified_memory_ = false;
+        }
+        else if (vk_memory_properties_.memoryHeaps[type.heapIndex].size > (256ull << 20)) {
+            resizable_bar_ = true;
+        }
+    }
+    unified_memory_ = unified_memory_ && has_device_local;
+
+    // 每种用途给内存类型打分, 不满足必需属性的排除
+    auto score = [&](GpuMemoryUsage usage, VkMemoryPropertyFlags flags) -> int32_t {
+        bool device_local = flags & kDeviceLocal;
+        bool host_visible = flags & kHostVisible;
+        bool coherent = flags & kHostCoherent;
+        bool cached = flags & kHostCached;
+        switch (usage)
+        {
+        case GpuMemoryUsage::kDeviceOnly:
+            // 独显上把可映射显存留给 kDynamic. 系统内存排在最后, 显存超出预算时退到这里
+            if (!device_local) return 0;
+            return 8 + (host_visible && !unified_memory_ ? -2 : 0);
+        case GpuMemoryUsage::kUpload:
+            if (!host_visible) return -1;
+            return (coherent ? 4 : 0) + (cached ? 0 : 2) + (device_local && !unified_memory_ ? -2 : 1);
+        case GpuMemoryUsage::kReadback:
+            if (!host_visible) return -1;
+            return (cached ? 8 : 0) + (coherent ? 2 : 0);
+        case GpuMemoryUsage::kDynamic:
+            if (!host_visible) return -1;
+            return (device_local ? 8 : 0) + (coherent ? 4 : 0) + (cached ? 0 : 1);
+        case GpuMemoryUsage::kDemoted:
+            if (device_local) return -1;
+            return host_visible ? 1 : 2;
+        default:
+            return -1;
+        }
+    };
+
+    for (size_t usage = 0; usage < usage_types_.size(); usage++)
+    {
+        std::vector<std::pair<int32_t, uint32_t>> scored;
+        for (uint32_t i = 0; i < vk_memory_properties_.memoryTypeCount; i++)
+        {
+            VkMemoryPropertyFlags flags = vk_memory_properties_.memoryTypes[i].propertyFlags;
+            // 保护内存, 延迟分配和 AMD 设备一致内存等特殊类型不参与
+            if (flags & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT 
+                | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD))
+            {
+                continue;
+            }
+            int32_t value = score(static_cast<GpuMemoryUsage>(usage), flags);
+            if (value >= 0)
+            {
+                scored.emplace_back(value, i);
+            }
+        }
+        std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        usage_types_[usage].clear();
+        for (const auto& item : scored)
+        {
+            usage_types_[usage].push_back(item.second);
+        }
+    }
+
+    fmt::print("gpu memory: {} heaps, {} types, resizable bar: {}, unified memory: {}\n",
+        vk_memory_properties_.memoryHeapCount, vk_memory_properties_.memoryTypeCount, resizable_bar_, unified_memory_);
+}
+
+bool GpuAllocator::_AllocateDeviceMemory(VkDeviceSize size, uint32_t memory_type, bool check_budget, VkDeviceMemory& memory, void*& mapped)
+{
+    if (device_allocation_count_ >= max_allocation_count_)
+    {
+        fmt::print("gpu allocator: maxMemoryAllocationCount ({}) reached\n", max_allocation_count_);
+        return false;
+    }
+
+    // 超出堆预算时不申请, 由调用方退到下一个内存类型 (通常是系统内存)
+    uint32_t heap_index = vk_memory_properties_.memoryTypes[memory_type].heapIndex;
+    if (check_budget && budget_callback_ && !budget_callback_(heap_index, size))
+    {
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memory_type;
+
+    VkResult ret = vkAllocateMemory(vk_device_, &allocInfo, GpuHostCallbacks(), &memory);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkAllocateMemory ({} bytes, type {}) return error: {}\n", size, memory_type, ret);
+        return false;
+    }
+
+    // 可映射的内存都常驻映射, 调用方直接写 mapped, 映射失败时整次申请失败, 退到下一个内存类型
+    mapped = nullptr;
+    if (vk_memory_properties_.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        ret = vkMapMemory(vk_device_, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        if (ret != VK_SUCCESS)
+        {
+            fmt::print("vkMapMemory return error: {}\n", ret);
+            vkFreeMemory(vk_device_, memory, GpuHostCallbacks());
+            memory = VK_NULL_HANDLE;
+            mapped = nullptr;
+            return false;
+        }
+    }
+    device_allocation_count_++;
+    heap_usage_[heap_index] += size;
+    return true;
+}
+
+void GpuAllocator::_FreeDeviceMemory(VkDeviceMemory memory, bool mapped, VkDeviceSize size, uint32_t memory_type)
+{
+    if (mapped)
+    {
+        vkUnmapMemory(vk_device_, memory);
+    }
+    vkFreeMemory(vk_device_, memory, GpuHostCallbacks());
+    device_allocation_count_--;
+    heap_usage_[vk_memory_properties_.memoryTypes[memory_type].heapIndex] -= size;
+}
+
+GpuAllocator::Block* GpuAllocator::_CreateBlock(uint32_t memory_type, uint32_t pool, bool check_budget)
+{
+    auto block = std::make_unique<Block>();
+    if (!_AllocateDeviceMemory(block_size_, memory_type, check_budget, block->vk_memory, block->mapped))
+    {
+        return nullptr;
+    }
+    block->size = block_size_;
+    block->memory_type = memory_type;
+    block->pool = pool;
+    block->free_lists.resize(max_order_ + 1);
+    block->free_lists[max_order_].insert(0);
+
+    pools_[pool].push_back(std::move(block));
+    return pools_[pool].back().get();
+}
+
+void GpuAllocator::_RegisterSpareBlock(Block& block)
+{
+    if (!register_spare_block_ || block.spare_serial != 0)
+    {
+        return;
+    }
+    // 回调在驻留管理的驱逐中执行, 块可能已被重新使用或释放, 用序号重新查找
+    uint32_t pool = block.pool;
+    uint64_t serial = next_spare_serial_++;
+    block.spare_serial = serial;
+    block.spare_id = register_spare_block_(vk_memory_properties_.memoryTypes[block.memory_type].heapIndex, block.size,
+        [this, pool, serial]() { _ReleaseSpareBlock(pool, serial); });
+}
+
+void GpuAllocator::_UnregisterSpareBlock(Block& block)
+{
+    if (block.spare_serial == 0)
+    {
+        return;
+    }
+    if (unregister_spare_block_)
+    {
+        unregister_spare_block_(block.spare_id);
+    }
+    block.spare_serial = 0;
+    block.spare_id = 0;
+}
+
+void GpuAllocator::_ReleaseSpareBlock(uint32_t pool_index, uint64_t serial)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& pool = pools_[pool_index];
+    auto iter = std::find_if(pool.begin(), pool.end(), [serial](const auto& item) { return item->spare_serial == serial; });
+    if (iter == pool.end() || (*iter)->used != 0)
+    {
+        return;
+    }
+    Block* block = iter->get();
+    _FreeDeviceMemory(block->vk_memory, block->mapped != nullptr, block->size, block->memory_type);
+    pool.erase(iter);
+}
+
+bool GpuAllocator::_AllocateFromBlock(Block& block, uint32_t order, VkDeviceSize& offset)
+{
+    uint32_t found = order;
+    while (found <= max_order_ && block.free_lists[found].empty())
+    {
+        found++;
+    }
+    if (found > max_order_)
+    {
+        return false;
+    }
+
+    offset = *block.free_lists[found].begin();
+    block.free_lists[found].erase(block.free_lists[found].begin());
+
+    // 逐级拆分, 高地址的一半放回空闲表
+    while (found > order)
+    {
+        found--;
+        block.free_lists[found].insert(offset + (kMinBlockSize << found));
+    }
+    return true;
+}
+
+void GpuAllocator::_FreeToBlock(Block& block, VkDeviceSize offset, uint32_t order)
+{
+    // 伙伴也空闲时合并成上一阶
+    while (order < max_order_)
+    {
+        VkDeviceSize buddy = offset ^ (kMinBlockSize << order);
+        auto iter = block.free_lists[order].find(buddy);
+        if (iter == block.free_lists[order].end())
+        {
+            break;
+        }
+        block.free_lists[order].erase(iter);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block.free_lists[order].insert(offset);
+}
+
+uint32_t GpuAllocator::_PoolIndex(uint32_t memory_type, GpuResourceTiling tiling) const
+{
+    // 粒度为 1 时线性资源和 OPTIMAL 图片可以共用内存块
+    if (buffer_image_granularity_ <= 1 || tiling == GpuResourceTiling::kLinear)
+    {
+        return memory_type * 2;
+    }
+    return memory_type * 2 + 1;
+}
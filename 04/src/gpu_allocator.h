@@ -0,0 +1,215 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/**
+ * @brief 资源在内存块中的排布方式
+ * bufferImageGranularity > 1 时线性资源 (buffer, LINEAR 图片) 和 OPTIMAL 图片不能相邻, 分开放在不同的内存块
+ */
+enum class GpuResourceTiling
+{
+    kLinear,
+    kOptimal,
+};
+
+/**
+ * @brief 内存用途分类, 设备创建时为每一类预先排好内存类型的优先顺序
+ */
+enum class GpuMemoryUsage
+{
+    kDeviceOnly,    ///< 只有 GPU 访问, 优先 DEVICE_LOCAL 且不占用 ReBAR 窗口
+    kUpload,        ///< CPU 顺序写入的暂存数据, HOST_VISIBLE, 不带 CACHED
+    kReadback,      ///< GPU 写回 CPU 读取, 优先 HOST_CACHED
+    kDynamic,       ///< CPU 每帧写 GPU 读, 优先 DEVICE_LOCAL + HOST_VISIBLE (ReBAR / 统一内存)
+    kDemoted,       ///< 显存超出预算时被驱逐的资源, 只用系统内存
+    kCount,
+};
+
+/**
+ * @brief 子分配结果, 指向某个内存块中的一段
+ */
+struct GpuAllocation
+{
+    VkDeviceMemory vk_memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;              ///< 实际占用大小 (伙伴块大小)
+    void* mapped = nullptr;             ///< HOST_VISIBLE 内存常驻映射后的地址, 已加上 offset
+    uint32_t memory_type = UINT32_MAX;
+    VkMemoryPropertyFlags property_flags = 0;
+
+    bool IsValid() const { return vk_memory != VK_NULL_HANDLE; }
+
+private:
+    friend class GpuAllocator;
+    void* block = nullptr;              ///< 所属内存块, 独立分配时为空
+    uint32_t order = 0;                 ///< 伙伴块阶数
+};
+
+struct GpuBuffer
+{
+    VkBuffer vk_buffer = VK_NULL_HANDLE;
+    GpuAllocation allocation;
+
+    VkDeviceSize Offset() const { return allocation.offset; }
+};
+
+struct GpuImage
+{
+    VkImage vk_image = VK_NULL_HANDLE;
+    GpuAllocation allocation;
+};
+
+/**
+ * @brief 显存子分配器
+ * 每种内存类型按块 (默认 64MB) 申请 VkDeviceMemory, 块内用伙伴算法切分,
+ * 块大小和偏移都是 2 的幂, 对齐要求不超过块大小时天然满足.
+ * 超过半个块的资源单独申请. HOST_VISIBLE 的块创建后常驻映射
+ */
+class GpuAllocator final
+{
+public:
+    GpuAllocator() = default;
+    ~GpuAllocator();
+
+    GpuAllocator(const GpuAllocator&) = delete;
+    GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+    /**
+     * @brief 初始化, 设备属性和内存属性由 GpuResource 在选择显卡时缓存后传入
+     */
+    bool Init(VkDevice device, const VkPhysicalDeviceProperties& properties, 
+        const VkPhysicalDeviceMemoryProperties& memory_properties, VkDeviceSize block_size = 64ull << 20);
+    void UnInit();
+
+    /**
+     * @brief 按用途分配, 内存类型直接查预先排好的表
+     */
+    bool Allocate(const VkMemoryRequirements& requirements, GpuMemoryUsage usage, GpuResourceTiling tiling, 
+        GpuAllocation& allocation);
+
+    /**
+     * @brief 分配内存
+     * @param required 必须满足的内存属性
+     * @param preferred 优先选择同时满足的内存类型, 没有时退回只满足 required
+     */
+    bool Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, 
+        VkMemoryPropertyFlags preferred, GpuResourceTiling tiling, GpuAllocation& allocation);
+    void Free(GpuAllocation& allocation);
+
+    /**
+     * @brief 创建 buffer 并绑定子分配的内存, 返回 (buffer, offset)
+     */
+    bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, 
+        VkMemoryPropertyFlags preferred, GpuBuffer& buffer);
+    bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, GpuMemoryUsage memory_usage, GpuBuffer& buffer);
+    void DestroyBuffer(GpuBuffer& buffer);
+
+    bool CreateImage(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags required, 
+        VkMemoryPropertyFlags preferred, GpuImage& image);
+    bool CreateImage(const VkImageCreateInfo& create_info, GpuMemoryUsage memory_usage, GpuImage& image);
+    void DestroyImage(GpuImage& image);
+
+    std::optional<uint32_t> FindMemoryType(uint32_t type_bits, VkMemoryPropertyFlags required, 
+        VkMemoryPropertyFlags preferred) const;
+
+    /**
+     * @brief 该用途下最优先的内存类型, 类型不在 type_bits 中时按优先顺序往后找
+     */
+    std::optional<uint32_t> FindMemoryType(uint32_t type_bits, GpuMemoryUsage usage) const;
+
+    /**
+     * @brief CPU 直接写入显存 (kDynamic) 是否比经暂存 buffer 拷贝更划算
+     * 统一内存和完整 ReBAR 总是直接写; 只有 256MB BAR 窗口时只有小数据直接写, 避免挤占窗口
+     */
+    bool PreferDirectWrite(VkDeviceSize size) const;
+
+    /**
+     * @brief 申请新的 VkDeviceMemory 前询问是否超出堆预算, 返回 false 时退到优先级更低的内存类型.
+     * 最后一个候选类型不再询问, 由驱动决定能否申请
+     */
+    void SetBudgetCallback(std::function<bool(uint32_t heap_index, VkDeviceSize size)> callback) { budget_callback_ = std::move(callback); }
+
+    /**
+     * @brief 空内存块保留在池中时登记为可驱逐, 被驱逐时归还驱动; 块重新被使用时注销
+     * @param register_block 返回登记 id, 传给 unregister_block
+     */
+    void SetSpareBlockCallbacks(std::function<uint64_t(uint32_t heap_index, VkDeviceSize size, std::function<void()> evict)> register_block,
+        std::function<void(uint64_t id)> unregister_block);
+
+    /**
+     * @brief 本进程通过该分配器在某个堆上申请的总字节数
+     */
+    VkDeviceSize GetHeapUsage(uint32_t heap_index) const { return heap_usage_[heap_index].load(std::memory_order_relaxed); }
+
+    bool HasResizableBar() const { return resizable_bar_; }
+    bool IsUnifiedMemory() const { return unified_memory_; }
+
+    const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const { return vk_memory_properties_; }
+    VkDevice GetDevice() const { return vk_device_; }
+
+    /**
+     * @brief 当前 vkAllocateMemory 次数, 用于对照 maxMemoryAllocationCount
+     */
+    uint32_t GetDeviceAllocationCount() const { return device_allocation_count_; }
+
+private:
+    struct Block
+    {
+        VkDeviceMemory vk_memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        uint32_t memory_type = 0;
+        uint32_t pool = 0;
+        VkDeviceSize used = 0;
+        std::vector<std::set<VkDeviceSize>> free_lists;   ///< 每一阶空闲块的偏移, 取最低地址减少碎片
+        uint64_t spare_serial = 0;      ///< 作为空闲保留块登记时的序号, 0 表示未登记
+        uint64_t spare_id = 0;          ///< 驻留管理返回的登记 id
+    };
+
+    bool _Allocate(const VkMemoryRequirements& requirements, const std::vector<uint32_t>& memory_types,
+        GpuResourceTiling tiling, GpuAllocation& allocation);
+    void _BuildUsageTable();
+    bool _AllocateDeviceMemory(VkDeviceSize size, uint32_t memory_type, bool check_budget, VkDeviceMemory& memory, void*& mapped);
+    void _FreeDeviceMemory(VkDeviceMemory memory, bool mapped, VkDeviceSize size, uint32_t memory_type);
+    Block* _CreateBlock(uint32_t memory_type, uint32_t pool, bool check_budget);
+    void _RegisterSpareBlock(Block& block);
+    void _UnregisterSpareBlock(Block& block);
+    void _ReleaseSpareBlock(uint32_t pool_index, uint64_t serial);
+    bool _AllocateFromBlock(Block& block, uint32_t order, VkDeviceSize& offset);
+    void _FreeToBlock(Block& block, VkDeviceSize offset, uint32_t order);
+    uint32_t _PoolIndex(uint32_t memory_type, GpuResourceTiling tiling) const;
+
+private:
+    static constexpr VkDeviceSize kMinBlockSize = 256;  ///< 最小伙伴块
+
+    static constexpr VkDeviceSize kSmallBarDirectWriteLimit = 64 << 10;  ///< 小 BAR 窗口下直接写的上限
+
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties vk_memory_properties_{};
+    VkDeviceSize block_size_ = 0;
+    uint32_t max_order_ = 0;
+    VkDeviceSize buffer_image_granularity_ = 1;
+    uint32_t max_allocation_count_ = 4096;
+    uint32_t device_allocation_count_ = 0;
+    std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> heap_usage_{};   ///< 每个堆已申请的字节数
+    std::function<bool(uint32_t, VkDeviceSize)> budget_callback_;
+    std::function<uint64_t(uint32_t, VkDeviceSize, std::function<void()>)> register_spare_block_;
+    std::function<void(uint64_t)> unregister_spare_block_;
+    uint64_t next_spare_serial_ = 1;
+
+    std::array<std::vector<uint32_t>, static_cast<size_t>(GpuMemoryUsage::kCount)> usage_types_;   ///< 每种用途可用的内存类型, 按优先级排序
+    bool resizable_bar_ = false;    ///< 存在大于 256MB 的 DEVICE_LOCAL + HOST_VISIBLE 堆
+    bool unified_memory_ = false;   ///< 所有 DEVICE_LOCAL 类型都 HOST_VISIBLE (集成显卡)
+
+    std::mutex mutex_;
+    std::vector<std::vector<std::unique_ptr<Block>>> pools_;   ///< 按 (内存类型, 排布方式) 分组的内存块
+};
@@ -1,4 +1,39 @@
-#pragma once
-
-#include <vulkan/vulkan.hpp>
-#include <fmt/format.h>
\ No newline at end of file
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.hpp>
+#include <fmt/format.h>
+
+/**
+ * @brief 呈现策略, 同时决定呈现模式和交换链图片数量
+ */
+enum class PresentProfile
+{
+    kBalanced,      ///< MAILBOX > FIFO > IMMEDIATE, 多申请一张图片
+    kLowLatency,    ///< MAILBOX > IMMEDIATE > FIFO, 尽量少的排队帧, 允许撕裂
+    kPowerSaving,   ///< FIFO 垂直同步, 双缓冲, 让 GPU 尽量空闲
+    kMaxThroughput, ///< IMMEDIATE > MAILBOX > FIFO, 不受刷新率限制, 用于压测
+};
+
+/**
+ * @brief GpuProgram 初始化参数
+ */
+struct GpuConfig
+{
+    bool headless = false;  ///< 无窗口模式: 不创建 surface 和交换链, 渲染到离屏图片
+    VkExtent2D headless_extent = { 800, 600 };  ///< 离屏图片大小
+    uint32_t headless_image_count = 3;  ///< 离屏图片数量, 轮流作为渲染目标
+    uint32_t frames_in_flight = 2;  ///< 帧上下文环深度
+    PresentProfile present_profile = PresentProfile::kBalanced; ///< 呈现策略, 运行时可切换
+    VkDeviceSize staging_size = 16ull << 20;    ///< 帧内上传暂存环大小
+    VkDeviceSize upload_staging_size = 32ull << 20; ///< 异步上传引擎的暂存环大小
+    VkDeviceSize frame_allocator_size = 4ull << 20; ///< 每个帧上下文的线性分配器大小
+    std::string pipeline_cache_path = "pipeline_cache.bin";  ///< 管线缓存文件, 为空时不读写磁盘
+    uint32_t pipeline_compile_threads = 0;  ///< 管线编译线程数, 0 表示 CPU 核数减一
+    bool shader_hot_reload = false; ///< 监视着色器文件, 变化后在后台重新编译管线
+    std::string shader_compiler = "glslc";  ///< 热重载时编译 GLSL 源文件的命令
+    bool dynamic_rendering = true;  ///< 设备支持时使用动态渲染, 不创建渲染通道和帧缓冲
+    bool host_allocator = true; ///< 驱动主机内存走 GpuHostAllocator 并统计, 关闭时使用驱动默认分配
+    bool validation = false;    ///< 开启校验层, 没有安装时警告后继续. 会拖慢帧率, 校验层自身的分配也会被计数
+    float brightness = 1.0f;    ///< 片元着色器的特化常量 kBrightness, 管线编译时代入
+};
@@ -0,0 +1,38 @@
+#include "gpu_deletion_queue.h"
+
+#include <algorithm>
+
+GpuDeletionQueue::~GpuDeletionQueue()
+{
+    Flush();
+}
+
+void GpuDeletionQueue::Push(uint64_t retire_value, std::function<void()> deleter)
+{
+    // 保持队列按 retire_value 有序, 回收时只需检查队首
+    if (!entries_.empty())
+    {
+        retire_value = std::max(retire_value, entries_.back().retire_value);
+    }
+    entries_.push_back({ retire_value, std::move(deleter) });
+}
+
+void GpuDeletionQueue::Collect(uint64_t completed_value)
+{
+    while (!entries_.empty() && entries_.front().retire_value <= completed_value)
+    {
+        Entry entry = std::move(entries_.front());
+        entries_.pop_front();
+        entry.deleter();
+    }
+}
+
+void GpuDeletionQueue::Flush()
+{
+    while (!entries_.empty())
+    {
+        Entry entry = std::move(entries_.front());
+        entries_.pop_front();
+        entry.deleter();
+    }
+}
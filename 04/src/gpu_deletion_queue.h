@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/**
+ * @brief 延迟释放队列
+ * 资源登记时附带一个 timeline 值, GPU 完成到该值后才真正释放,
+ * 代替 vkDeviceWaitIdle 之后立即销毁. 只在渲染线程使用, 不加锁
+ */
+class GpuDeletionQueue final
+{
+public:
+    GpuDeletionQueue() = default;
+    ~GpuDeletionQueue();
+
+    /**
+     * @brief 登记待释放资源
+     * @param retire_value timeline 到达该值后执行 deleter, 需按非递减顺序登记
+     */
+    void Push(uint64_t retire_value, std::function<void()> deleter);
+
+    /**
+     * @brief 释放所有 retire_value <= completed_value 的资源
+     */
+    void Collect(uint64_t completed_value);
+
+    /**
+     * @brief 立即释放全部资源, 调用前需保证设备空闲
+     */
+    void Flush();
+
+    bool Empty() const { return entries_.empty(); }
+
+private:
+    struct Entry
+    {
+        uint64_t retire_value = 0;
+        std::function<void()> deleter;
+    };
+    std::deque<Entry> entries_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "gpu_hash.h"
+
+/**
+ * @brief 构建时编译并嵌入程序的 SPIR-V
+ * 由 CMake 调用 glslc 和 spirv-opt 生成, 数组和内容哈希都是编译期常量, 启动时不读文件
+ */
+struct GpuEmbeddedShader
+{
+    const uint32_t* code = nullptr;
+    size_t size = 0;            ///< 字节数
+    uint64_t hash = 0;          ///< 与 GpuShaderCache 对同样内容计算的哈希相同
+    const char* source = nullptr;   ///< GLSL 源文件名, 用于日志
+};
+
+template <size_t N>
+constexpr GpuEmbeddedShader GpuMakeEmbeddedShader(const uint32_t (&code)[N], const char* source)
+{
+    return GpuEmbeddedShader{ code, N * sizeof(uint32_t), GpuHashWords(code, N), source };
+}
@@ -0,0 +1,57 @@
+#include "gpu_frame_allocator.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+
+bool GpuFrameAllocator::Init(GpuAllocator* allocator, VkDeviceSize size, const VkPhysicalDeviceLimits& limits)
+{
+    allocator_ = allocator;
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    if (!allocator_->CreateBuffer(size, usage, GpuMemoryUsage::kDynamic, buffer_))
+    {
+        return false;
+    }
+    if (buffer_.allocation.mapped == nullptr)
+    {
+        fmt::print("frame allocator: buffer is not mapped\n");
+        allocator_->DestroyBuffer(buffer_);
+        return false;
+    }
+
+    base_ = static_cast<uint8_t*>(buffer_.allocation.mapped);
+    size_ = size;
+    head_ = 0;
+    uniform_alignment_ = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+    storage_alignment_ = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 16);
+    bool coherent = buffer_.allocation.property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    atom_size_ = coherent ? 1 : std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+    return true;
+}
+
+void GpuFrameAllocator::UnInit()
+{
+    if (allocator_ != nullptr)
+    {
+        allocator_->DestroyBuffer(buffer_);
+        allocator_ = nullptr;
+    }
+    base_ = nullptr;
+    size_ = 0;
+    head_ = 0;
+}
+
+void GpuFrameAllocator::Flush()
+{
+    if (atom_size_ == 1 || head_ == 0)
+    {
+        return;
+    }
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = buffer_.allocation.vk_memory;
+    range.offset = buffer_.allocation.offset;
+    range.size = std::min((head_ + atom_size_ - 1) / atom_size_ * atom_size_, buffer_.allocation.size);
+    vkFlushMappedMemoryRanges(allocator_->GetDevice(), 1, &range);
+}
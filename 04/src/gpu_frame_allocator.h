@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vulkan/vulkan.hpp>
+#include "gpu_allocator.h"
+
+/**
+ * @brief 帧内分配得到的一段, 写 mapped, GPU 侧使用 (vk_buffer, offset)
+ */
+struct GpuFrameSlice
+{
+    void* mapped = nullptr;
+    VkBuffer vk_buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;        ///< 相对 vk_buffer 的偏移, 不含 allocation.offset
+    VkDeviceSize size = 0;
+
+    bool IsValid() const { return mapped != nullptr; }
+};
+
+/**
+ * @brief 帧内线性分配器
+ * 每个帧上下文一块常驻映射的 buffer, uniform, 动态顶点/索引, indirect 参数都从里面顺序切分,
+ * 不再为每个对象创建 buffer. 帧的 timeline 值完成后 Reset 整体回收, 分配只是一次对齐加法
+ */
+class GpuFrameAllocator final
+{
+public:
+    GpuFrameAllocator() = default;
+    GpuFrameAllocator(GpuFrameAllocator&&) = default;
+    GpuFrameAllocator& operator=(GpuFrameAllocator&&) = default;
+    GpuFrameAllocator(const GpuFrameAllocator&) = delete;
+    GpuFrameAllocator& operator=(const GpuFrameAllocator&) = delete;
+
+    /**
+     * @brief 申请 buffer, 释放需要调用 UnInit
+     */
+    bool Init(GpuAllocator* allocator, VkDeviceSize size, const VkPhysicalDeviceLimits& limits);
+    void UnInit();
+
+    /**
+     * @brief 顺序切分, 空间不足时返回无效的 slice
+     * @param alignment 需为 2 的幂
+     */
+    GpuFrameSlice Allocate(VkDeviceSize size, VkDeviceSize alignment)
+    {
+        VkDeviceSize offset = (head_ + alignment - 1) & ~(alignment - 1);
+        if (offset + size > size_)
+        {
+            return {};
+        }
+        head_ = offset + size;
+        return GpuFrameSlice{ base_ + offset, buffer_.vk_buffer, offset, size };
+    }
+
+    GpuFrameSlice AllocateUniform(VkDeviceSize size) { return Allocate(size, uniform_alignment_); }
+    GpuFrameSlice AllocateStorage(VkDeviceSize size) { return Allocate(size, storage_alignment_); }
+
+    /**
+     * @brief 切分并拷贝数据
+     */
+    GpuFrameSlice Push(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16)
+    {
+        GpuFrameSlice slice = Allocate(size, alignment);
+        if (slice.IsValid())
+        {
+            memcpy(slice.mapped, data, static_cast<size_t>(size));
+        }
+        return slice;
+    }
+
+    /**
+     * @brief 帧开始时调用, 调用前需保证该帧上一轮的 timeline 值已经完成
+     */
+    void Reset() { head_ = 0; }
+
+    /**
+     * @brief 提交前把本帧写入的范围 flush, HOST_COHERENT 内存不需要
+     */
+    void Flush();
+
+    VkDeviceSize Used() const { return head_; }
+    VkDeviceSize Size() const { return size_; }
+
+private:
+    GpuAllocator* allocator_ = nullptr;
+    GpuBuffer buffer_;
+    uint8_t* base_ = nullptr;
+    VkDeviceSize size_ = 0;
+    VkDeviceSize head_ = 0;
+    VkDeviceSize uniform_alignment_ = 256;
+    VkDeviceSize storage_alignment_ = 256;
+    VkDeviceSize atom_size_ = 1;    ///< 非一致内存 flush 的对齐粒度, 一致内存为 1
+};
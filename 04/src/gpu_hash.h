@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief FNV-1a 64 位哈希, 用于缓存键和文件校验, 不用于安全场景
+ */
+inline uint64_t GpuHash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief 编译期可用的 GpuHash, 按小端字节序逐字哈希, 结果与对 SPIR-V 文件内容调用 GpuHash 相同
+ */
+constexpr uint64_t GpuHashWords(const uint32_t* words, size_t count, uint64_t seed = 0xcbf29ce484222325ull)
+{
+    uint64_t hash = seed;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            hash ^= (words[i] >> shift) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief 按字节哈希没有填充的结构体, 填充字节的值不确定, 会导致相同的键哈希不同
+ */
+template <typename T>
+inline uint64_t GpuHashPod(const T& value, uint64_t seed = 0xcbf29ce484222325ull)
+{
+    static_assert(std::has_unique_object_representations_v<T>, "key must not contain padding");
+    return GpuHash(&value, sizeof(T), seed);
+}
+
+/**
+ * @brief vulkan 句柄转成整数, 64 位平台上非分发句柄是指针, 32 位平台上是 uint64_t
+ */
+template <typename T>
+inline uint64_t GpuHandleValue(T handle)
+{
+    if constexpr (std::is_pointer_v<T>)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+    }
+    else {
+        return static_cast<uint64_t>(handle);
+    }
+}
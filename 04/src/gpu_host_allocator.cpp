@@ -0,0 +1,326 @@
+#include "gpu_host_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fmt/format.h>
+
+namespace {
+// 每块分配前面放一个头, 释放时据此找到来源和原始地址
+enum class BlockOrigin : uint32_t
+{
+    kMalloc,
+    kPool,
+    kArena,
+};
+
+struct CommandArena;
+
+struct alignas(16) BlockHeader
+{
+    uint64_t size;          ///< 调用方请求的大小
+    uint32_t scope;
+    BlockOrigin origin;
+    uint32_t size_class;
+    uint32_t offset;        ///< 用户地址到原始地址的距离
+    CommandArena* arena;    ///< 来自 arena 时记录所属 arena, 其他线程释放时据此递减计数
+};
+
+/**
+ * @brief COMMAND 作用域用的 arena, 每个线程一个, 没有存活分配时从头复用.
+ * 驱动可能在另一个线程释放, 所以计数是原子的; head 只由所属线程读写.
+ * 所属线程也持有一个引用, 线程退出后最后一次释放负责回收
+ */
+struct CommandArena
+{
+    static constexpr size_t kSize = 64 << 10;
+
+    std::atomic<size_t> refs{ 1 };  ///< 存活分配数 + 所属线程的引用
+    size_t head = 0;
+    alignas(16) uint8_t buffer[kSize];
+};
+
+void ReleaseArena(CommandArena* arena)
+{
+    if (arena->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        arena->~CommandArena();
+        free(arena);
+    }
+}
+
+/**
+ * @brief 线程局部的 arena 指针, 线程退出时放弃所属线程的引用
+ */
+struct ThreadArena
+{
+    CommandArena* arena = nullptr;
+
+    ~ThreadArena()
+    {
+        if (arena != nullptr)
+        {
+            ReleaseArena(arena);
+        }
+    }
+};
+
+thread_local ThreadArena tls_command_arena;
+
+uint8_t* PlaceHeader(uint8_t* base, size_t size, size_t alignment, VkSystemAllocationScope scope, 
+    BlockOrigin origin, uint32_t size_class, CommandArena* arena = nullptr)
+{
+    uintptr_t user = (reinterpret_cast<uintptr_t>(base) + sizeof(BlockHeader) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(user) - 1;
+    header->size = size;
+    header->scope = static_cast<uint32_t>(scope);
+    header->origin = origin;
+    header->size_class = size_class;
+    header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(base));
+    header->arena = arena;
+    return reinterpret_cast<uint8_t*>(user);
+}
+
+BlockHeader* GetHeader(void* memory)
+{
+    return static_cast<BlockHeader*>(memory) - 1;
+}
+}
+
+GpuHostAllocator* GpuHostAllocator::GetInstance()
+{
+    static GpuHostAllocator obj;
+    return &obj;
+}
+
+GpuHostAllocator::GpuHostAllocator()
+{
+    callbacks_.pUserData = this;
+    callbacks_.pfnAllocation = &GpuHostAllocator::_OnAllocation;
+    callbacks_.pfnReallocation = &GpuHostAllocator::_OnReallocation;
+    callbacks_.pfnFree = &GpuHostAllocator::_OnFree;
+    callbacks_.pfnInternalAllocation = &GpuHostAllocator::_OnInternalAllocation;
+    callbacks_.pfnInternalFree = &GpuHostAllocator::_OnInternalFree;
+}
+
+GpuHostAllocator::~GpuHostAllocator()
+{
+    for (auto& list : free_lists_)
+    {
+        for (void* base : list)
+        {
+            free(base);
+        }
+        list.clear();
+    }
+}
+
+GpuHostScopeStats GpuHostAllocator::GetStats(VkSystemAllocationScope scope) const
+{
+    const AtomicStats& stats = stats_[static_cast<uint32_t>(scope) % kScopeCount];
+    GpuHostScopeStats result;
+    result.bytes = stats.bytes.load(std::memory_order_relaxed);
+    result.peak_bytes = stats.peak_bytes.load(std::memory_order_relaxed);
+    result.count = stats.count.load(std::memory_order_relaxed);
+    result.total_count = stats.total_count.load(std::memory_order_relaxed);
+    result.internal_bytes = stats.internal_bytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+void GpuHostAllocator::PrintStats() const
+{
+    if (!enabled_)
+    {
+        return;
+    }
+
+    static const char* kScopeNames[kScopeCount] = { "command", "object", "cache", "device", "instance" };
+    fmt::print("vulkan host allocations:\n");
+    for (uint32_t i = 0; i < kScopeCount; i++)
+    {
+        GpuHostScopeStats stats = GetStats(static_cast<VkSystemAllocationScope>(i));
+        fmt::print("  {:<8} total {:>8}, live {:>6} ({} bytes), peak {} bytes, internal {} bytes\n",
+            kScopeNames[i], stats.total_count, stats.count, stats.bytes, stats.peak_bytes, stats.internal_bytes);
+    }
+}
+
+void* GpuHostAllocator::_Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+    alignment = std::max(alignment, alignof(BlockHeader));
+    size_t total = size + sizeof(BlockHeader) + alignment - 1;
+
+    uint8_t* user = nullptr;
+    if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && total <= CommandArena::kSize)
+    {
+        ThreadArena& local = tls_command_arena;
+        if (local.arena == nullptr)
+        {
+            void* storage = malloc(sizeof(CommandArena));
+            local.arena = storage != nullptr ? new (storage) CommandArena() : nullptr;
+        }
+        if (local.arena != nullptr)
+        {
+            CommandArena& arena = *local.arena;
+            // 只剩所属线程的引用, 说明包括其他线程持有的在内都已释放, 可以从头复用
+            if (arena.refs.load(std::memory_order_acquire) == 1)
+            {
+                arena.head = 0;
+            }
+            if (arena.head + total <= CommandArena::kSize)
+            {
+                user = PlaceHeader(arena.buffer + arena.head, size, alignment, scope, BlockOrigin::kArena, 0, &arena);
+                arena.head += total;
+                arena.refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    if (user == nullptr && total <= (size_t(1) << (kMinClassShift + kClassCount - 1)))
+    {
+        uint32_t size_class = std::max<uint32_t>(std::bit_width(total - 1), kMinClassShift) - kMinClassShift;
+        void* base = _PoolAllocate(size_class);
+        if (base != nullptr)
+        {
+            user = PlaceHeader(static_cast<uint8_t*>(base), size, alignment, scope, BlockOrigin::kPool, size_class);
+        }
+    }
+
+    if (user == nullptr)
+    {
+        void* base = malloc(total);
+        if (base == nullptr)
+        {
+            return nullptr;
+        }
+        user = PlaceHeader(static_cast<uint8_t*>(base), size, alignment, scope, BlockOrigin::kMalloc, 0);
+    }
+
+    _AddStats(scope, size);
+    return user;
+}
+
+void* GpuHostAllocator::_Reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (original == nullptr)
+    {
+        return _Allocate(size, alignment, scope);
+    }
+    if (size == 0)
+    {
+        _Free(original);
+        return nullptr;
+    }
+
+    BlockHeader* header = GetHeader(original);
+    void* memory = _Allocate(size, alignment, scope);
+    if (memory != nullptr)
+    {
+        memcpy(memory, original, static_cast<size_t>(std::min<uint64_t>(header->size, size)));
+        _Free(original);
+    }
+    return memory;
+}
+
+void GpuHostAllocator::_Free(void* memory)
+{
+    if (memory == nullptr)
+    {
+        return;
+    }
+
+    BlockHeader* header = GetHeader(memory);
+    _SubStats(static_cast<VkSystemAllocationScope>(header->scope), header->size);
+    uint8_t* base = static_cast<uint8_t*>(memory) - header->offset;
+    switch (header->origin)
+    {
+    case BlockOrigin::kArena:
+        // 可能不是分配时的线程, 不能用当前线程的 arena. 只递减计数, 由所属线程下次分配时从头复用
+        ReleaseArena(header->arena);
+        break;
+    case BlockOrigin::kPool:
+        _PoolFree(base, header->size_class);
+        break;
+    default:
+        free(base);
+        break;
+    }
+}
+
+void* GpuHostAllocator::_PoolAllocate(uint32_t size_class)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        auto& list = free_lists_[size_class];
+        if (!list.empty())
+        {
+            void* base = list.back();
+            list.pop_back();
+            return base;
+        }
+    }
+    return malloc(size_t(1) << (size_class + kMinClassShift));
+}
+
+void GpuHostAllocator::_PoolFree(void* base, uint32_t size_class)
+{
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    free_lists_[size_class].push_back(base);
+}
+
+void GpuHostAllocator::_AddStats(VkSystemAllocationScope scope, uint64_t size)
+{
+    AtomicStats& stats = stats_[static_cast<uint32_t>(scope) % kScopeCount];
+    uint64_t bytes = stats.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.total_count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t peak = stats.peak_bytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !stats.peak_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+    {
+    }
+}
+
+void GpuHostAllocator::_SubStats(VkSystemAllocationScope scope, uint64_t size)
+{
+    AtomicStats& stats = stats_[static_cast<uint32_t>(scope) % kScopeCount];
+    stats.bytes.fetch_sub(size, std::memory_order_relaxed);
+    stats.count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void* VKAPI_CALL GpuHostAllocator::_OnAllocation(void* user_data, size_t size, size_t alignment, 
+    VkSystemAllocationScope scope)
+{
+    return static_cast<GpuHostAllocator*>(user_data)->_Allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL GpuHostAllocator::_OnReallocation(void* user_data, void* original, size_t size, size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    return static_cast<GpuHostAllocator*>(user_data)->_Reallocate(original, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL GpuHostAllocator::_OnFree(void* user_data, void* memory)
+{
+    static_cast<GpuHostAllocator*>(user_data)->_Free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL GpuHostAllocator::_OnInternalAllocation(void* user_data, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    auto* self = static_cast<GpuHostAllocator*>(user_data);
+    self->stats_[static_cast<uint32_t>(scope) % kScopeCount].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL GpuHostAllocator::_OnInternalFree(void* user_data, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    auto* self = static_cast<GpuHostAllocator*>(user_data);
+    self->stats_[static_cast<uint32_t>(scope) % kScopeCount].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/**
+ * @brief 单个 VkSystemAllocationScope 的统计
+ */
+struct GpuHostScopeStats
+{
+    uint64_t bytes = 0;             ///< 当前占用字节数
+    uint64_t peak_bytes = 0;        ///< 峰值
+    uint64_t count = 0;             ///< 当前存活的分配数
+    uint64_t total_count = 0;       ///< 累计分配次数
+    uint64_t internal_bytes = 0;    ///< 驱动自己申请 (只通知) 的可执行内存等
+};
+
+/**
+ * @brief 驱动主机内存分配回调
+ * COMMAND 作用域的分配只在一次 vk 调用期间存活, 走线程局部的线性 arena, 没有存活分配时归零, 允许在其他线程释放;
+ * 其余作用域的小块按大小分级放进空闲链表复用, 大块直接走 malloc.
+ * 每个作用域统计字节数, 次数和峰值. 需在创建实例前 SetEnabled, 之后不能改变
+ */
+class GpuHostAllocator final
+{
+public:
+    static GpuHostAllocator* GetInstance();
+
+    void SetEnabled(bool enabled) { enabled_ = enabled; }
+    bool IsEnabled() const { return enabled_; }
+
+    /**
+     * @brief 传给 vkCreateXxx / vkDestroyXxx 的 pAllocator, 未开启时为空
+     */
+    const VkAllocationCallbacks* Callbacks() const { return enabled_ ? &callbacks_ : nullptr; }
+
+    GpuHostScopeStats GetStats(VkSystemAllocationScope scope) const;
+    void PrintStats() const;
+
+private:
+    GpuHostAllocator();
+    ~GpuHostAllocator();
+
+    void* _Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* _Reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void _Free(void* memory);
+
+    void* _PoolAllocate(uint32_t size_class);
+    void _PoolFree(void* base, uint32_t size_class);
+
+    void _AddStats(VkSystemAllocationScope scope, uint64_t size);
+    void _SubStats(VkSystemAllocationScope scope, uint64_t size);
+
+    static VKAPI_ATTR void* VKAPI_CALL _OnAllocation(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL _OnReallocation(void* user_data, void* original, size_t size, size_t alignment, 
+        VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL _OnFree(void* user_data, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL _OnInternalAllocation(void* user_data, size_t size, VkInternalAllocationType type, 
+        VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL _OnInternalFree(void* user_data, size_t size, VkInternalAllocationType type, 
+        VkSystemAllocationScope scope);
+
+private:
+    static constexpr uint32_t kScopeCount = 5;
+    static constexpr uint32_t kMinClassShift = 5;   ///< 最小分级 32 字节
+    static constexpr uint32_t kClassCount = 8;      ///< 32 ~ 4096 字节
+
+    struct AtomicStats
+    {
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<uint64_t> peak_bytes = 0;
+        std::atomic<uint64_t> count = 0;
+        std::atomic<uint64_t> total_count = 0;
+        std::atomic<uint64_t> internal_bytes = 0;
+    };
+
+    bool enabled_ = false;
+    VkAllocationCallbacks callbacks_{};
+    std::array<AtomicStats, kScopeCount> stats_;
+
+    std::mutex pool_mutex_;
+    std::array<std::vector<void*>, kClassCount> free_lists_;   ///< 对象作用域小块的空闲链表
+};
+
+/**
+ * @brief 所有 vkCreateXxx / vkDestroyXxx 统一使用的 pAllocator
+ */
+inline const VkAllocationCallbacks* GpuHostCallbacks()
+{
+    return GpuHostAllocator::GetInstance()->Callbacks();
+}
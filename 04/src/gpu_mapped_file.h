@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 只读内存映射文件, 内容按需由系统分页读入, 不经过用户态拷贝
+ * 映射起始地址按页对齐, 可以直接当作 uint32_t 数组使用
+ */
+class GpuMappedFile final
+{
+public:
+    GpuMappedFile() = default;
+    ~GpuMappedFile();
+
+    GpuMappedFile(const GpuMappedFile&) = delete;
+    GpuMappedFile& operator=(const GpuMappedFile&) = delete;
+    GpuMappedFile(GpuMappedFile&& other) noexcept;
+    GpuMappedFile& operator=(GpuMappedFile&& other) noexcept;
+
+    /**
+     * @brief 映射整个文件, 文件不存在或为空时返回 false
+     */
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool IsOpen() const { return data_ != nullptr; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;      ///< HANDLE
+    void* mapping_ = nullptr;   ///< HANDLE
+#endif
+};
@@ -0,0 +1,339 @@
+#include "gpu_pipeline_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fmt/format.h>
+#include "gpu_hash.h"
+#include "gpu_host_allocator.h"
+
+GpuPipelineCache::~GpuPipelineCache()
+{
+    UnInit();
+}
+
+bool GpuPipelineCache::Init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path)
+{
+    vk_device_ = device;
+    vk_properties_ = properties;
+    path_ = path;
+    temp_path_ = path.empty() ? std::string() : path + ".tmp";
+
+    initial_data_.clear();
+    if (!path_.empty() && !_Load(initial_data_))
+    {
+        initial_data_.clear();
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = initial_data_.size();
+    createInfo.pInitialData = initial_data_.empty() ? nullptr : initial_data_.data();
+    VkResult ret = vkCreatePipelineCache(vk_device_, &createInfo, GpuHostCallbacks(), &vk_pipeline_cache_);
+    if (ret != VK_SUCCESS && !initial_data_.empty())
+    {
+        // 校验通过但驱动仍然拒绝, 丢弃旧数据重试
+        fmt::print("vkCreatePipelineCache rejected {} bytes from {}, error: {}\n", initial_data_.size(), path_, ret);
+        initial_data_.clear();
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        ret = vkCreatePipelineCache(vk_device_, &createInfo, GpuHostCallbacks(), &vk_pipeline_cache_);
+    }
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreatePipelineCache return error: {}\n", ret);
+        vk_pipeline_cache_ = VK_NULL_HANDLE;
+        return false;
+    }
+
+    saved_size_ = initial_data_.size();
+    last_save_time_ = std::chrono::steady_clock::now();
+    if (!path_.empty())
+    {
+        fmt::print("pipeline cache: {} bytes loaded from {}\n", initial_data_.size(), path_);
+        save_stop_ = false;
+        save_requested_ = false;
+        save_thread_ = std::thread(&GpuPipelineCache::_SaveLoop, this);
+    }
+    return true;
+}
+
+void GpuPipelineCache::UnInit()
+{
+    if (vk_pipeline_cache_ == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    _MergeWorkerCaches();
+    if (save_thread_.joinable())
+    {
+        // 等待上一次写入完成后再写最终结果
+        {
+            std::unique_lock<std::mutex> lock(save_mutex_);
+            save_cv_.wait(lock, [this] { return !save_requested_; });
+        }
+        Save();
+        {
+            std::lock_guard<std::mutex> lock(save_mutex_);
+            save_stop_ = true;
+        }
+        save_cv_.notify_all();
+        save_thread_.join();
+    }
+
+    vkDestroyPipelineCache(vk_device_, vk_pipeline_cache_, GpuHostCallbacks());
+    vk_pipeline_cache_ = VK_NULL_HANDLE;
+    initial_data_.clear();
+    save_data_.clear();
+}
+
+VkPipelineCache GpuPipelineCache::CreateWorkerCache()
+{
+    // initial_data_ 初始化后只读, 多线程同时创建不需要加锁
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = initial_data_.size();
+    createInfo.pInitialData = initial_data_.empty() ? nullptr : initial_data_.data();
+
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkResult ret = vkCreatePipelineCache(vk_device_, &createInfo, GpuHostCallbacks(), &cache);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreatePipelineCache return error: {}\n", ret);
+        return VK_NULL_HANDLE;
+    }
+    return cache;
+}
+
+void GpuPipelineCache::ReturnWorkerCache(VkPipelineCache cache)
+{
+    if (cache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    returned_caches_.push_back(cache);
+}
+
+void GpuPipelineCache::Update()
+{
+    if (vk_pipeline_cache_ == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    _MergeWorkerCaches();
+    if (path_.empty())
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_save_time_ < kSaveInterval)
+    {
+        return;
+    }
+    last_save_time_ = now;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(vk_device_, vk_pipeline_cache_, &size, nullptr) != VK_SUCCESS || size == saved_size_)
+    {
+        return;
+    }
+    Save();
+}
+
+bool GpuPipelineCache::Save()
+{
+    if (vk_pipeline_cache_ == VK_NULL_HANDLE || !save_thread_.joinable())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(save_mutex_);
+    if (save_requested_)
+    {
+        return false;
+    }
+
+    // 两次调用之间其他线程不会修改主缓存, 大小不会变化
+    size_t size = 0;
+    VkResult ret = vkGetPipelineCacheData(vk_device_, vk_pipeline_cache_, &size, nullptr);
+    if (ret == VK_SUCCESS)
+    {
+        // 缓存没有增长时复用上次的空间
+        save_data_.resize(size);
+        ret = vkGetPipelineCacheData(vk_device_, vk_pipeline_cache_, &size, save_data_.data());
+    }
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkGetPipelineCacheData return error: {}\n", ret);
+        return false;
+    }
+    save_data_.resize(size);
+
+    saved_size_ = size;
+    save_requested_ = true;
+    save_cv_.notify_all();
+    return true;
+}
+
+bool GpuPipelineCache::_Load(std::vector<uint8_t>& data)
+{
+    std::ifstream file(path_, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        // 第一次运行还没有缓存文件
+        return false;
+    }
+
+    std::streamoff file_size = file.tellg();
+    FileHeader header;
+    if (file_size < static_cast<std::streamoff>(sizeof(header)))
+    {
+        fmt::print("pipeline cache {} is truncated, ignored\n", path_);
+        return false;
+    }
+
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion
+        || header.data_size != static_cast<uint64_t>(file_size) - sizeof(header))
+    {
+        fmt::print("pipeline cache {} has a bad header, ignored\n", path_);
+        return false;
+    }
+
+    if (header.driver_version != vk_properties_.driverVersion)
+    {
+        fmt::print("pipeline cache {} was built by another driver version, ignored\n", path_);
+        return false;
+    }
+
+    data.resize(static_cast<size_t>(header.data_size));
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    if (!file || GpuHash(data.data(), data.size()) != header.data_hash)
+    {
+        fmt::print("pipeline cache {} is corrupted, ignored\n", path_);
+        return false;
+    }
+
+    return _ValidateCacheHeader(data.data(), data.size());
+}
+
+bool GpuPipelineCache::_ValidateCacheHeader(const uint8_t* data, size_t size) const
+{
+    // 损坏或其他显卡的数据交给驱动, 部分驱动会直接崩溃, 先自己检查
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header))
+    {
+        fmt::print("pipeline cache {} is truncated, ignored\n", path_);
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.headerSize < sizeof(header) || header.headerSize > size
+        || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    {
+        fmt::print("pipeline cache {} has an unknown header version, ignored\n", path_);
+        return false;
+    }
+
+    if (header.vendorID != vk_properties_.vendorID || header.deviceID != vk_properties_.deviceID
+        || std::memcmp(header.pipelineCacheUUID, vk_properties_.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        fmt::print("pipeline cache {} was built for another device or driver, ignored\n", path_);
+        return false;
+    }
+    return true;
+}
+
+void GpuPipelineCache::_MergeWorkerCaches()
+{
+    // 交回的缓存很少, 换出来后在锁外合并, 不阻塞编译线程
+    std::vector<VkPipelineCache> caches;
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        if (returned_caches_.empty())
+        {
+            return;
+        }
+        caches.swap(returned_caches_);
+    }
+
+    VkResult ret = vkMergePipelineCaches(vk_device_, vk_pipeline_cache_, static_cast<uint32_t>(caches.size()), caches.data());
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkMergePipelineCaches return error: {}\n", ret);
+    }
+
+    for (auto& cache : caches)
+    {
+        vkDestroyPipelineCache(vk_device_, cache, GpuHostCallbacks());
+    }
+}
+
+void GpuPipelineCache::_SaveLoop()
+{
+    std::unique_lock<std::mutex> lock(save_mutex_);
+    while (true)
+    {
+        save_cv_.wait(lock, [this] { return save_requested_ || save_stop_; });
+        if (save_requested_)
+        {
+            // 写文件期间渲染线程看到 save_requested_ 为 true 不会修改 save_data_
+            lock.unlock();
+            _WriteFile(save_data_);
+            lock.lock();
+            save_requested_ = false;
+            save_cv_.notify_all();
+            continue;
+        }
+
+        if (save_stop_)
+        {
+            break;
+        }
+    }
+}
+
+bool GpuPipelineCache::_WriteFile(const std::vector<uint8_t>& data)
+{
+    FileHeader header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.driver_version = vk_properties_.driverVersion;
+    header.data_size = data.size();
+    header.data_hash = GpuHash(data.data(), data.size());
+
+    {
+        std::ofstream file(temp_path_, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            fmt::print("pipeline cache: failed to open {}\n", temp_path_);
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        file.close();
+        if (!file)
+        {
+            fmt::print("pipeline cache: failed to write {}\n", temp_path_);
+            std::error_code ec;
+            std::filesystem::remove(temp_path_, ec);
+            return false;
+        }
+    }
+
+    // rename 覆盖旧文件是原子的, 读到的要么是旧缓存要么是新缓存
+    std::error_code ec;
+    std::filesystem::rename(temp_path_, path_, ec);
+    if (ec)
+    {
+        fmt::print("pipeline cache: failed to replace {}: {}\n", path_, ec.message());
+        std::filesystem::remove(temp_path_, ec);
+        return false;
+    }
+    return true;
+}
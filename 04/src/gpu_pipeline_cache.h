@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+/**
+ * @brief 持久化的管线缓存
+ * 启动时从磁盘读取缓存数据, 校验文件头和驱动的 vendorID/deviceID/pipelineCacheUUID, 不匹配时丢弃从空缓存开始.
+ * 主缓存只在渲染线程使用; 编译线程各自申请工作缓存, 用完交回后在渲染线程合并进主缓存.
+ * 缓存有变化时定期写回, 写文件在后台线程进行, 先写临时文件再 rename 替换, 中途崩溃不会留下半个文件
+ */
+class GpuPipelineCache final
+{
+public:
+    GpuPipelineCache() = default;
+    ~GpuPipelineCache();
+
+    GpuPipelineCache(const GpuPipelineCache&) = delete;
+    GpuPipelineCache& operator=(const GpuPipelineCache&) = delete;
+
+    /**
+     * @param path 缓存文件路径, 为空时只在内存中缓存
+     */
+    bool Init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path);
+
+    /**
+     * @brief 合并工作缓存并写回磁盘, 调用前需保证没有线程还在使用缓存
+     */
+    void UnInit();
+
+    /**
+     * @brief 主缓存, 只在渲染线程创建管线时使用
+     */
+    VkPipelineCache Get() const { return vk_pipeline_cache_; }
+
+    /**
+     * @brief 给编译线程的工作缓存, 用磁盘数据初始化, 任意线程调用
+     * @return 创建失败时返回 VK_NULL_HANDLE, 此时不带缓存创建管线即可
+     */
+    VkPipelineCache CreateWorkerCache();
+
+    /**
+     * @brief 交回工作缓存, 下次 Update 时合并进主缓存并销毁, 任意线程调用
+     */
+    void ReturnWorkerCache(VkPipelineCache cache);
+
+    /**
+     * @brief 每帧在渲染线程调用, 合并交回的工作缓存, 缓存有变化且超过保存间隔时写回磁盘
+     */
+    void Update();
+
+    /**
+     * @brief 立即把主缓存写回磁盘, 上一次写入还没完成时返回 false
+     */
+    bool Save();
+
+private:
+    /**
+     * @brief 磁盘文件头, 后面紧跟 vkGetPipelineCacheData 的数据
+     */
+    struct FileHeader
+    {
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t driver_version = 0;    ///< 有些驱动升级后不更新 pipelineCacheUUID, 额外比较驱动版本
+        uint32_t reserved = 0;
+        uint64_t data_size = 0;
+        uint64_t data_hash = 0;         ///< 数据的 FNV-1a 哈希, 检查截断和损坏
+    };
+
+    bool _Load(std::vector<uint8_t>& data);
+    bool _ValidateCacheHeader(const uint8_t* data, size_t size) const;
+    void _MergeWorkerCaches();
+    void _SaveLoop();
+    bool _WriteFile(const std::vector<uint8_t>& data);
+
+private:
+    static constexpr uint32_t kMagic = 0x43505056;  ///< "VPPC"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr std::chrono::seconds kSaveInterval{ 60 };
+
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties vk_properties_{};
+    VkPipelineCache vk_pipeline_cache_ = VK_NULL_HANDLE;
+    std::string path_;
+    std::string temp_path_;
+    std::vector<uint8_t> initial_data_;     ///< 启动时读到的数据, 用于初始化工作缓存, 之后不再修改
+
+    std::mutex worker_mutex_;
+    std::vector<VkPipelineCache> returned_caches_;  ///< 已交回等待合并的工作缓存
+
+    size_t saved_size_ = 0;     ///< 上次写回时的数据大小, 大小不变认为没有新管线
+    std::chrono::steady_clock::time_point last_save_time_;
+
+    // 后台写文件线程
+    std::thread save_thread_;
+    std::mutex save_mutex_;
+    std::condition_variable save_cv_;
+    std::vector<uint8_t> save_data_;    ///< 待写入的数据, 写入期间渲染线程不会修改
+    bool save_requested_ = false;
+    bool save_stop_ = false;
+};
@@ -0,0 +1,283 @@
+#include "gpu_pipeline_compiler.h"
+
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+#include "gpu_host_allocator.h"
+#include "gpu_pipeline_cache.h"
+
+GpuPipelineCompiler::~GpuPipelineCompiler()
+{
+    UnInit();
+}
+
+bool GpuPipelineCompiler::Init(VkDevice device, GpuPipelineCache* cache, uint32_t thread_count)
+{
+    vk_device_ = device;
+    cache_ = cache;
+    if (thread_count == 0)
+    {
+        // 留一个核给渲染线程
+        uint32_t cores = std::thread::hardware_concurrency();
+        thread_count = cores > 1 ? cores - 1 : 1;
+    }
+
+    stop_ = false;
+    busy_count_ = 0;
+    workers_.reserve(thread_count);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        workers_.emplace_back(&GpuPipelineCompiler::_WorkerLoop, this);
+    }
+    fmt::print("pipeline compiler: {} threads\n", thread_count);
+    return true;
+}
+
+void GpuPipelineCompiler::UnInit()
+{
+    if (workers_.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        for (auto& job : queue_)
+        {
+            job->status.store(GpuPipelineStatus::kFailed, std::memory_order_release);
+        }
+        queue_.clear();
+    }
+    work_cv_.notify_all();
+    done_cv_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+    cache_ = nullptr;
+}
+
+GpuPipelineHandle GpuPipelineCompiler::Compile(const GraphicsPipelineDesc& desc)
+{
+    GpuPipelineHandle handle;
+    handle.job_ = std::make_shared<GpuPipelineJob>();
+    handle.job_->desc = desc;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_ || workers_.empty())
+        {
+            handle.job_->status.store(GpuPipelineStatus::kFailed, std::memory_order_release);
+            return handle;
+        }
+        queue_.push_back(handle.job_);
+    }
+    work_cv_.notify_one();
+    return handle;
+}
+
+void GpuPipelineCompiler::Wait(const GpuPipelineHandle& handle)
+{
+    if (!handle.IsValid())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&handle] { return handle.Status() != GpuPipelineStatus::kPending; });
+}
+
+void GpuPipelineCompiler::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return queue_.empty() && busy_count_ == 0; });
+}
+
+VkResult GpuPipelineCompiler::CreatePipeline(VkDevice device, VkPipelineCache cache,
+                                            const GraphicsPipelineDesc& desc, VkPipeline* pipeline)
+{
+    // 着色器
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = desc.vertex_shader;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = desc.fragment_shader;
+    shaderStages[1].pName = "main";
+
+    // 特化常量, 每个常量占 4 字节, 按顺序排列在 values 中
+    std::array<std::array<VkSpecializationMapEntry, GpuSpecialization::kMaxConstants>, 2> specEntries{};
+    std::array<VkSpecializationInfo, 2> specInfos{};
+    std::array<const GpuSpecialization*, 2> specs = { &desc.vertex_constants, &desc.fragment_constants };
+    for (size_t stage = 0; stage < specs.size(); stage++)
+    {
+        const GpuSpecialization& spec = *specs[stage];
+        if (spec.Empty())
+        {
+            continue;
+        }
+        uint32_t count = std::min(spec.count, GpuSpecialization::kMaxConstants);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            specEntries[stage][i].constantID = spec.ids[i];
+            specEntries[stage][i].offset = i * sizeof(uint32_t);
+            specEntries[stage][i].size = sizeof(uint32_t);
+        }
+        specInfos[stage].mapEntryCount = count;
+        specInfos[stage].pMapEntries = specEntries[stage].data();
+        specInfos[stage].dataSize = count * sizeof(uint32_t);
+        specInfos[stage].pData = spec.values.data();
+        shaderStages[stage].pSpecializationInfo = &specInfos[stage];
+    }
+
+    const GpuPipelineState& state = desc.state;
+
+    // 顶点输入
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = std::min(state.vertex_layout.binding_count, GpuVertexLayout::kMaxBindings);
+    vertexInputInfo.pVertexBindingDescriptions = state.vertex_layout.bindings.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = std::min(state.vertex_layout.attribute_count, GpuVertexLayout::kMaxAttributes);
+    vertexInputInfo.pVertexAttributeDescriptions = state.vertex_layout.attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = state.topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // 视口和裁剪在录制时设置
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = state.polygon_mode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = state.cull_mode;
+    rasterizer.frontFace = state.front_face;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = state.samples;
+
+    // 深度测试, 渲染通道没有深度附件时驱动忽略
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = state.depth_test;
+    depthStencil.depthWriteEnable = state.depth_write;
+    depthStencil.depthCompareOp = state.depth_compare;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    // 混合
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.blendEnable = state.blend_enable;
+    colorBlendAttachment.colorWriteMask = state.color_write_mask;
+    colorBlendAttachment.srcColorBlendFactor = state.src_color_factor;
+    colorBlendAttachment.dstColorBlendFactor = state.dst_color_factor;
+    colorBlendAttachment.colorBlendOp = state.color_op;
+    colorBlendAttachment.srcAlphaBlendFactor = state.src_alpha_factor;
+    colorBlendAttachment.dstAlphaBlendFactor = state.dst_alpha_factor;
+    colorBlendAttachment.alphaBlendOp = state.alpha_op;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    // 动态渲染没有渲染通道, 附件格式直接写进管线
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &desc.color_format;
+    renderingInfo.depthAttachmentFormat = desc.depth_format;
+    renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = desc.render_pass == VK_NULL_HANDLE ? &renderingInfo : nullptr;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = desc.layout;
+    pipelineInfo.renderPass = desc.render_pass;
+    pipelineInfo.subpass = desc.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    return vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, GpuHostCallbacks(), pipeline);
+}
+
+void GpuPipelineCompiler::_WorkerLoop()
+{
+    // 每个线程独立的缓存, 多个线程写同一个缓存会在驱动内部互斥
+    VkPipelineCache worker_cache = VK_NULL_HANDLE;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        if (queue_.empty() && worker_cache != VK_NULL_HANDLE)
+        {
+            // 一批编译结束, 交回缓存让渲染线程合并, 下一批重新申请
+            cache_->ReturnWorkerCache(worker_cache);
+            worker_cache = VK_NULL_HANDLE;
+        }
+
+        work_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_)
+        {
+            break;
+        }
+
+        std::shared_ptr<GpuPipelineJob> job = std::move(queue_.front());
+        queue_.pop_front();
+        busy_count_++;
+        lock.unlock();
+
+        if (worker_cache == VK_NULL_HANDLE)
+        {
+            worker_cache = cache_->CreateWorkerCache();
+        }
+
+        VkResult ret = CreatePipeline(vk_device_, worker_cache, job->desc, &job->vk_pipeline);
+        if (ret != VK_SUCCESS)
+        {
+            fmt::print("vkCreateGraphicsPipelines return error: {}\n", ret);
+            job->vk_pipeline = VK_NULL_HANDLE;
+        }
+        job->status.store(ret == VK_SUCCESS ? GpuPipelineStatus::kReady : GpuPipelineStatus::kFailed,
+            std::memory_order_release);
+
+        lock.lock();
+        busy_count_--;
+        done_cv_.notify_all();
+    }
+
+    if (worker_cache != VK_NULL_HANDLE)
+    {
+        cache_->ReturnWorkerCache(worker_cache);
+    }
+}
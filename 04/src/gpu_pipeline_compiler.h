@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+class GpuPipelineCache;
+
+/**
+ * @brief 顶点输入布局, 定长数组, 可以直接按字节哈希
+ */
+struct GpuVertexLayout
+{
+    static constexpr uint32_t kMaxBindings = 4;
+    static constexpr uint32_t kMaxAttributes = 16;
+
+    uint32_t binding_count = 0;
+    uint32_t attribute_count = 0;
+    std::array<VkVertexInputBindingDescription, kMaxBindings> bindings{};
+    std::array<VkVertexInputAttributeDescription, kMaxAttributes> attributes{};
+};
+
+/**
+ * @brief 固定功能状态, 全部是 32 位字段, 没有填充, 管线库按字节哈希和比较
+ */
+struct GpuPipelineState
+{
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkBool32 depth_test = VK_FALSE;
+    VkBool32 depth_write = VK_FALSE;
+    VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+
+    VkBool32 blend_enable = VK_FALSE;
+    VkBlendFactor src_color_factor = VK_BLEND_FACTOR_SRC_ALPHA;
+    VkBlendFactor dst_color_factor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    VkBlendOp color_op = VK_BLEND_OP_ADD;
+    VkBlendFactor src_alpha_factor = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dst_alpha_factor = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp alpha_op = VK_BLEND_OP_ADD;
+    VkColorComponentFlags color_write_mask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+        | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    GpuVertexLayout vertex_layout;
+};
+
+/**
+ * @brief 单个着色器阶段的特化常量
+ * 管线编译时把常量值代入着色器, 驱动可以按常量展开循环和消除分支, 不需要运行时判断.
+ * 常量按 constant_id 有序存放, 相同的常量集合字节相同, 直接参与管线键的哈希.
+ * 只支持 32 位的 int / uint / float / bool
+ */
+struct GpuSpecialization
+{
+    static constexpr uint32_t kMaxConstants = 16;
+
+    uint32_t count = 0;
+    std::array<uint32_t, kMaxConstants> ids{};
+    std::array<uint32_t, kMaxConstants> values{};  ///< 按位保存, 作为 VkSpecializationInfo::pData
+
+    bool SetInt(uint32_t constant_id, int32_t value) { return _Set(constant_id, static_cast<uint32_t>(value)); }
+    bool SetUint(uint32_t constant_id, uint32_t value) { return _Set(constant_id, value); }
+    bool SetBool(uint32_t constant_id, bool value) { return _Set(constant_id, value ? VK_TRUE : VK_FALSE); }
+    bool SetFloat(uint32_t constant_id, float value)
+    {
+        uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return _Set(constant_id, bits);
+    }
+
+    bool Empty() const { return count == 0; }
+
+private:
+    /**
+     * @brief 已存在时覆盖, 否则按 id 有序插入, 超过容量返回 false
+     */
+    bool _Set(uint32_t constant_id, uint32_t bits)
+    {
+        uint32_t pos = 0;
+        while (pos < count && ids[pos] < constant_id)
+        {
+            pos++;
+        }
+        if (pos < count && ids[pos] == constant_id)
+        {
+            values[pos] = bits;
+            return true;
+        }
+        if (count == kMaxConstants)
+        {
+            return false;
+        }
+        for (uint32_t i = count; i > pos; i--)
+        {
+            ids[i] = ids[i - 1];
+            values[i] = values[i - 1];
+        }
+        ids[pos] = constant_id;
+        values[pos] = bits;
+        count++;
+        return true;
+    }
+};
+
+/**
+ * @brief 图形管线描述, 值类型, 可以拷贝到编译线程
+ * 视口和裁剪固定为动态状态, 交换链大小变化时不需要重新编译
+ */
+struct GraphicsPipelineDesc
+{
+    VkShaderModule vertex_shader = VK_NULL_HANDLE;      ///< 编译完成前调用方需保证模块有效
+    VkShaderModule fragment_shader = VK_NULL_HANDLE;
+    uint64_t vertex_hash = 0;       ///< SPIR-V 内容哈希, 管线库用它代替模块句柄去重
+    uint64_t fragment_hash = 0;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass render_pass = VK_NULL_HANDLE;     ///< 为空时使用动态渲染, 由下面的附件格式描述目标
+    uint32_t subpass = 0;
+    VkFormat color_format = VK_FORMAT_UNDEFINED;    ///< 仅动态渲染使用
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;
+    GpuPipelineState state;
+    GpuSpecialization vertex_constants;     ///< 顶点着色器的特化常量
+    GpuSpecialization fragment_constants;   ///< 片元着色器的特化常量
+};
+
+enum class GpuPipelineStatus
+{
+    kPending,   ///< 排队或编译中
+    kReady,
+    kFailed,
+};
+
+/**
+ * @brief 编译任务, 由编译器和句柄共享
+ */
+struct GpuPipelineJob
+{
+    GraphicsPipelineDesc desc;
+    VkPipeline vk_pipeline = VK_NULL_HANDLE;    ///< status 变为 kReady 后才可读
+    std::atomic<GpuPipelineStatus> status = GpuPipelineStatus::kPending;
+};
+
+/**
+ * @brief 异步编译的管线句柄, 渲染线程每帧轮询, 不加锁
+ */
+class GpuPipelineHandle
+{
+public:
+    GpuPipelineHandle() = default;
+
+    bool IsValid() const { return job_ != nullptr; }
+    GpuPipelineStatus Status() const { return job_ ? job_->status.load(std::memory_order_acquire) : GpuPipelineStatus::kFailed; }
+    bool IsReady() const { return Status() == GpuPipelineStatus::kReady; }
+
+    /**
+     * @brief 编译完成返回管线, 否则返回 fallback (例如提前同步编译的简单管线)
+     */
+    VkPipeline Get(VkPipeline fallback = VK_NULL_HANDLE) const { return IsReady() ? job_->vk_pipeline : fallback; }
+
+private:
+    friend class GpuPipelineCompiler;
+    friend class GpuPipelineLibrary;
+    std::shared_ptr<GpuPipelineJob> job_;
+};
+
+/**
+ * @brief 管线编译服务
+ * 提交描述后立即返回句柄, 由线程池并行编译, 启动耗时随核数而不是管线数量增长.
+ * 每个编译线程使用独立的工作缓存, 队列空闲时交回给 GpuPipelineCache 合并.
+ * 编译出的管线归调用方所有, 由调用方销毁
+ */
+class GpuPipelineCompiler final
+{
+public:
+    GpuPipelineCompiler() = default;
+    ~GpuPipelineCompiler();
+
+    GpuPipelineCompiler(const GpuPipelineCompiler&) = delete;
+    GpuPipelineCompiler& operator=(const GpuPipelineCompiler&) = delete;
+
+    /**
+     * @param thread_count 编译线程数, 0 表示 CPU 核数减一
+     */
+    bool Init(VkDevice device, GpuPipelineCache* cache, uint32_t thread_count);
+
+    /**
+     * @brief 等待正在编译的任务, 还没开始的任务标记为失败
+     */
+    void UnInit();
+
+    GpuPipelineHandle Compile(const GraphicsPipelineDesc& desc);
+
+    /**
+     * @brief 阻塞直到该管线编译结束 (成功或失败)
+     */
+    void Wait(const GpuPipelineHandle& handle);
+
+    /**
+     * @brief 阻塞直到队列清空
+     */
+    void WaitIdle();
+
+    uint32_t ThreadCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+    /**
+     * @brief 按描述同步创建管线, 编译线程和需要立即可用的管线共用
+     */
+    static VkResult CreatePipeline(VkDevice device, VkPipelineCache cache, const GraphicsPipelineDesc& desc, VkPipeline* pipeline);
+
+private:
+    void _WorkerLoop();
+
+private:
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    GpuPipelineCache* cache_ = nullptr;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<std::shared_ptr<GpuPipelineJob>> queue_;
+    uint32_t busy_count_ = 0;   ///< 正在编译的任务数
+    bool stop_ = false;
+};
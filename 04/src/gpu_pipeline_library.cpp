@@ -0,0 +1,496 @@
+#include "gpu_pipeline_library.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include "gpu_hash.h"
+#include "gpu_host_allocator.h"
+
+namespace {
+/**
+ * @brief 清零计数之外的槽位, 调用方没有初始化的部分不影响哈希
+ */
+void NormalizeVertexLayout(GpuVertexLayout& layout)
+{
+    layout.binding_count = std::min(layout.binding_count, GpuVertexLayout::kMaxBindings);
+    layout.attribute_count = std::min(layout.attribute_count, GpuVertexLayout::kMaxAttributes);
+    std::fill(layout.bindings.begin() + layout.binding_count, layout.bindings.end(), VkVertexInputBindingDescription{});
+    std::fill(layout.attributes.begin() + layout.attribute_count, layout.attributes.end(), VkVertexInputAttributeDescription{});
+}
+
+void NormalizeSpecialization(GpuSpecialization& spec)
+{
+    spec.count = std::min(spec.count, GpuSpecialization::kMaxConstants);
+    std::fill(spec.ids.begin() + spec.count, spec.ids.end(), 0u);
+    std::fill(spec.values.begin() + spec.count, spec.values.end(), 0u);
+}
+
+void NormalizeSetLayoutDesc(GpuDescriptorSetLayoutDesc& desc)
+{
+    desc.binding_count = std::min(desc.binding_count, GpuDescriptorSetLayoutDesc::kMaxBindings);
+    desc.reserved = 0;
+    std::fill(desc.bindings.begin() + desc.binding_count, desc.bindings.end(), VkDescriptorSetLayoutBinding{});
+    std::sort(desc.bindings.begin(), desc.bindings.begin() + desc.binding_count,
+        [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+}
+
+void NormalizeLayoutDesc(GpuPipelineLayoutDesc& desc)
+{
+    desc.set_count = std::min(desc.set_count, GpuPipelineLayoutDesc::kMaxSets);
+    desc.push_constant_count = std::min(desc.push_constant_count, GpuPipelineLayoutDesc::kMaxPushConstants);
+    std::fill(desc.set_layouts.begin() + desc.set_count, desc.set_layouts.end(), VkDescriptorSetLayout{ VK_NULL_HANDLE });
+    std::fill(desc.push_constants.begin() + desc.push_constant_count, desc.push_constants.end(), VkPushConstantRange{});
+}
+
+/**
+ * @brief 渲染通道兼容类, 加载/存储操作和布局不影响兼容性, 只看附件格式和采样数
+ * 动态渲染的管线不能用于渲染通道, 反之亦然, 两者分属不同的类
+ */
+uint64_t CompatibleClass(VkFormat color_format, VkSampleCountFlagBits samples, VkFormat depth_format, bool dynamic_rendering)
+{
+    std::array<uint32_t, 4> compatible = {
+        static_cast<uint32_t>(color_format),
+        static_cast<uint32_t>(samples),
+        static_cast<uint32_t>(depth_format),
+        dynamic_rendering ? 1u : 0u,
+    };
+    return GpuHashPod(compatible);
+}
+}
+
+GpuPipelineLibrary::~GpuPipelineLibrary()
+{
+    UnInit();
+}
+
+bool GpuPipelineLibrary::Init(VkDevice device, GpuPipelineCompiler* compiler)
+{
+    vk_device_ = device;
+    compiler_ = compiler;
+    return true;
+}
+
+void GpuPipelineLibrary::UnInit()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [key, entry] : pipelines_)
+    {
+        compiler_->Wait(entry.handle);
+        VkPipeline pipeline = entry.handle.Get();
+        if (pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(vk_device_, pipeline, GpuHostCallbacks());
+        }
+    }
+    pipelines_.clear();
+    pipeline_keys_.clear();
+
+    for (auto& [key, entry] : framebuffers_)
+    {
+        vkDestroyFramebuffer(vk_device_, entry.vk_framebuffer, GpuHostCallbacks());
+    }
+    framebuffers_.clear();
+    framebuffer_keys_.clear();
+
+    for (auto& [key, layout] : layouts_)
+    {
+        vkDestroyPipelineLayout(vk_device_, layout, GpuHostCallbacks());
+    }
+    layouts_.clear();
+
+    for (auto& [key, set_layout] : set_layouts_)
+    {
+        vkDestroyDescriptorSetLayout(vk_device_, set_layout, GpuHostCallbacks());
+    }
+    set_layouts_.clear();
+
+    for (auto& [key, render_pass] : render_passes_)
+    {
+        vkDestroyRenderPass(vk_device_, render_pass, GpuHostCallbacks());
+    }
+    render_passes_.clear();
+    render_pass_classes_.clear();
+}
+
+VkRenderPass GpuPipelineLibrary::GetRenderPass(const GpuRenderPassDesc& desc)
+{
+    HashedKey<RenderPassKey> key;
+    key.key.color_format = desc.color_format;
+    key.key.samples = desc.samples;
+    key.key.load_op = desc.load_op;
+    key.key.store_op = desc.store_op;
+    key.key.initial_layout = desc.initial_layout;
+    key.key.final_layout = desc.final_layout;
+    key.key.depth_format = desc.depth_format;
+    key.hash = GpuHashPod(key.key);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = render_passes_.find(key);
+    if (iter != render_passes_.end())
+    {
+        return iter->second;
+    }
+
+    VkRenderPass render_pass = _CreateRenderPass(desc);
+    if (render_pass == VK_NULL_HANDLE)
+    {
+        return VK_NULL_HANDLE;
+    }
+    render_passes_.emplace(key, render_pass);
+
+    render_pass_classes_.emplace(render_pass, CompatibleClass(desc.color_format, desc.samples, desc.depth_format, false));
+    return render_pass;
+}
+
+VkDescriptorSetLayout GpuPipelineLibrary::GetDescriptorSetLayout(const GpuDescriptorSetLayoutDesc& desc)
+{
+    HashedKey<GpuDescriptorSetLayoutDesc> key;
+    key.key = desc;
+    NormalizeSetLayoutDesc(key.key);
+    key.hash = GpuHashPod(key.key);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = set_layouts_.find(key);
+    if (iter != set_layouts_.end())
+    {
+        return iter->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = key.key.binding_count;
+    layoutInfo.pBindings = key.key.binding_count > 0 ? key.key.bindings.data() : nullptr;
+
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VkResult ret = vkCreateDescriptorSetLayout(vk_device_, &layoutInfo, GpuHostCallbacks(), &set_layout);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateDescriptorSetLayout return error: {}\n", ret);
+        return VK_NULL_HANDLE;
+    }
+    set_layouts_.emplace(key, set_layout);
+    return set_layout;
+}
+
+VkPipelineLayout GpuPipelineLibrary::GetPipelineLayout(const GpuShaderReflection& reflection)
+{
+    std::array<GpuDescriptorSetLayoutDesc, GpuPipelineLayoutDesc::kMaxSets> set_descs{};
+    GpuPipelineLayoutDesc desc;
+    for (const auto& binding : reflection.bindings)
+    {
+        if (binding.set >= GpuPipelineLayoutDesc::kMaxSets
+            || set_descs[binding.set].binding_count >= GpuDescriptorSetLayoutDesc::kMaxBindings)
+        {
+            fmt::print("descriptor set {} binding {} exceeds the layout limits\n", binding.set, binding.binding);
+            return VK_NULL_HANDLE;
+        }
+        GpuDescriptorSetLayoutDesc& set_desc = set_descs[binding.set];
+        VkDescriptorSetLayoutBinding& layout_binding = set_desc.bindings[set_desc.binding_count++];
+        layout_binding.binding = binding.binding;
+        layout_binding.descriptorType = binding.type;
+        layout_binding.descriptorCount = binding.count;
+        layout_binding.stageFlags = binding.stages;
+        desc.set_count = std::max(desc.set_count, binding.set + 1);
+    }
+
+    for (uint32_t i = 0; i < desc.set_count; i++)
+    {
+        desc.set_layouts[i] = GetDescriptorSetLayout(set_descs[i]);
+        if (desc.set_layouts[i] == VK_NULL_HANDLE)
+        {
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    if (reflection.push_constants.size > 0)
+    {
+        desc.push_constant_count = 1;
+        desc.push_constants[0] = reflection.push_constants;
+    }
+    return GetPipelineLayout(desc);
+}
+
+VkPipelineLayout GpuPipelineLibrary::GetPipelineLayout(const GpuPipelineLayoutDesc& desc)
+{
+    HashedKey<GpuPipelineLayoutDesc> key;
+    key.key = desc;
+    NormalizeLayoutDesc(key.key);
+    key.hash = GpuHashPod(key.key);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = layouts_.find(key);
+    if (iter != layouts_.end())
+    {
+        return iter->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = key.key.set_count;
+    pipelineLayoutInfo.pSetLayouts = key.key.set_count > 0 ? key.key.set_layouts.data() : nullptr;
+    pipelineLayoutInfo.pushConstantRangeCount = key.key.push_constant_count;
+    pipelineLayoutInfo.pPushConstantRanges = key.key.push_constant_count > 0 ? key.key.push_constants.data() : nullptr;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkResult ret = vkCreatePipelineLayout(vk_device_, &pipelineLayoutInfo, GpuHostCallbacks(), &layout);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreatePipelineLayout return error: {}\n", ret);
+        return VK_NULL_HANDLE;
+    }
+    layouts_.emplace(key, layout);
+    return layout;
+}
+
+GpuPipelineHandle GpuPipelineLibrary::GetPipeline(const GraphicsPipelineDesc& desc)
+{
+    HashedKey<PipelineKey> key;
+    key.key.vertex_hash = desc.vertex_hash;
+    key.key.fragment_hash = desc.fragment_hash;
+    key.key.layout = GpuHandleValue(desc.layout);
+    key.key.subpass = desc.subpass;
+    key.key.state = desc.state;
+    key.key.vertex_constants = desc.vertex_constants;
+    key.key.fragment_constants = desc.fragment_constants;
+    NormalizeVertexLayout(key.key.state.vertex_layout);
+    NormalizeSpecialization(key.key.vertex_constants);
+    NormalizeSpecialization(key.key.fragment_constants);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (desc.render_pass == VK_NULL_HANDLE)
+    {
+        key.key.render_pass_class = CompatibleClass(desc.color_format, desc.state.samples, desc.depth_format, true);
+    }
+    else {
+        auto class_iter = render_pass_classes_.find(desc.render_pass);
+        // 不是从库里创建的渲染通道, 只能按句柄区分
+        key.key.render_pass_class = class_iter != render_pass_classes_.end()
+            ? class_iter->second : GpuHandleValue(desc.render_pass);
+    }
+    key.hash = GpuHashPod(key.key);
+
+    auto iter = pipelines_.find(key);
+    if (iter != pipelines_.end())
+    {
+        iter->second.ref_count++;
+        return iter->second.handle;
+    }
+
+    GpuPipelineHandle handle = compiler_->Compile(desc);
+    if (handle.Status() != GpuPipelineStatus::kFailed)
+    {
+        pipelines_.emplace(key, PipelineEntry{ handle, 1 });
+        pipeline_keys_.emplace(handle.job_.get(), key);
+    }
+    return handle;
+}
+
+VkPipeline GpuPipelineLibrary::ReleasePipeline(const GpuPipelineHandle& handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key_iter = pipeline_keys_.find(handle.job_.get());
+    if (key_iter == pipeline_keys_.end())
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    auto iter = pipelines_.find(key_iter->second);
+    if (iter == pipelines_.end() || --iter->second.ref_count > 0)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    VkPipeline pipeline = iter->second.handle.Get();
+    pipelines_.erase(iter);
+    pipeline_keys_.erase(key_iter);
+    return pipeline;
+}
+
+size_t GpuPipelineLibrary::PipelineCount()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pipelines_.size();
+}
+
+VkFramebuffer GpuPipelineLibrary::GetFramebuffer(const GpuFramebufferDesc& desc)
+{
+    HashedKey<FramebufferKey> key;
+    key.key.width = desc.width;
+    key.key.height = desc.height;
+    key.key.layers = desc.layers;
+    key.key.color_format = desc.color_format;
+    key.key.color_usage = desc.color_usage;
+    key.key.color_flags = desc.color_flags;
+    key.key.depth_format = desc.depth_format;
+    key.key.depth_usage = desc.depth_format != VK_FORMAT_UNDEFINED ? desc.depth_usage : 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto class_iter = render_pass_classes_.find(desc.render_pass);
+    if (class_iter == render_pass_classes_.end())
+    {
+        fmt::print("framebuffer render pass is not from the library\n");
+        return VK_NULL_HANDLE;
+    }
+    // 帧缓冲可用于任何兼容的渲染通道, 按兼容类而不是句柄去重
+    key.key.render_pass_class = class_iter->second;
+    key.hash = GpuHashPod(key.key);
+
+    auto iter = framebuffers_.find(key);
+    if (iter != framebuffers_.end())
+    {
+        iter->second.ref_count++;
+        return iter->second.vk_framebuffer;
+    }
+
+    VkFramebuffer framebuffer = _CreateFramebuffer(desc);
+    if (framebuffer == VK_NULL_HANDLE)
+    {
+        return VK_NULL_HANDLE;
+    }
+    framebuffers_.emplace(key, FramebufferEntry{ framebuffer, 1 });
+    framebuffer_keys_.emplace(framebuffer, key);
+    return framebuffer;
+}
+
+VkFramebuffer GpuPipelineLibrary::ReleaseFramebuffer(VkFramebuffer framebuffer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key_iter = framebuffer_keys_.find(framebuffer);
+    if (key_iter == framebuffer_keys_.end())
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    auto iter = framebuffers_.find(key_iter->second);
+    if (iter == framebuffers_.end() || --iter->second.ref_count > 0)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    framebuffers_.erase(iter);
+    framebuffer_keys_.erase(key_iter);
+    return framebuffer;
+}
+
+VkRenderPass GpuPipelineLibrary::_CreateRenderPass(const GpuRenderPassDesc& desc)
+{
+    bool has_depth = desc.depth_format != VK_FORMAT_UNDEFINED;
+    std::array<VkAttachmentDescription, 2> attachments{};
+
+    VkAttachmentDescription& colorAttachment = attachments[0];
+    colorAttachment.format = desc.color_format;
+    colorAttachment.samples = desc.samples;
+    colorAttachment.loadOp = desc.load_op;
+    colorAttachment.storeOp = desc.store_op;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = desc.initial_layout;
+    colorAttachment.finalLayout = desc.final_layout;
+
+    VkAttachmentDescription& depthAttachment = attachments[1];
+    depthAttachment.format = desc.depth_format;
+    depthAttachment.samples = desc.samples;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = has_depth ? &depthAttachmentRef : nullptr;
+
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    if (has_depth)
+    {
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = has_depth ? 2 : 1;
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    VkResult ret = vkCreateRenderPass(vk_device_, &renderPassInfo, GpuHostCallbacks(), &render_pass);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateRenderPass return error: {}\n", ret);
+        return VK_NULL_HANDLE;
+    }
+    return render_pass;
+}
+
+VkFramebuffer GpuPipelineLibrary::_CreateFramebuffer(const GpuFramebufferDesc& desc)
+{
+    bool has_depth = desc.depth_format != VK_FORMAT_UNDEFINED;
+    std::array<VkFormat, 2> formats = { desc.color_format, desc.depth_format };
+    std::array<VkFramebufferAttachmentImageInfo, 2> imageInfos{};
+
+    VkFramebufferAttachmentImageInfo& colorInfo = imageInfos[0];
+    colorInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO;
+    colorInfo.flags = desc.color_flags;
+    colorInfo.usage = desc.color_usage;
+    colorInfo.width = desc.width;
+    colorInfo.height = desc.height;
+    colorInfo.layerCount = desc.layers;
+    colorInfo.viewFormatCount = 1;
+    colorInfo.pViewFormats = &formats[0];
+
+    VkFramebufferAttachmentImageInfo& depthInfo = imageInfos[1];
+    depthInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO;
+    depthInfo.usage = desc.depth_usage;
+    depthInfo.width = desc.width;
+    depthInfo.height = desc.height;
+    depthInfo.layerCount = desc.layers;
+    depthInfo.viewFormatCount = 1;
+    depthInfo.pViewFormats = &formats[1];
+
+    uint32_t attachment_count = has_depth ? 2 : 1;
+    VkFramebufferAttachmentsCreateInfo attachmentsInfo{};
+    attachmentsInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO;
+    attachmentsInfo.attachmentImageInfoCount = attachment_count;
+    attachmentsInfo.pAttachmentImageInfos = imageInfos.data();
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.pNext = &attachmentsInfo;
+    framebufferInfo.flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT;
+    framebufferInfo.renderPass = desc.render_pass;
+    framebufferInfo.attachmentCount = attachment_count;
+    framebufferInfo.pAttachments = nullptr;
+    framebufferInfo.width = desc.width;
+    framebufferInfo.height = desc.height;
+    framebufferInfo.layers = desc.layers;
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkResult ret = vkCreateFramebuffer(vk_device_, &framebufferInfo, GpuHostCallbacks(), &framebuffer);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateFramebuffer return error: {}\n", ret);
+        return VK_NULL_HANDLE;
+    }
+    return framebuffer;
+}
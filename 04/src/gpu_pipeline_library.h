@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vulkan/vulkan.hpp>
+#include "gpu_pipeline_compiler.h"
+#include "gpu_shader_reflect.h"
+
+/**
+ * @brief 单个颜色附件 (可选深度附件) 的渲染通道描述
+ */
+struct GpuRenderPassDesc
+{
+    VkFormat color_format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    VkAttachmentStoreOp store_op = VK_ATTACHMENT_STORE_OP_STORE;
+    VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;    ///< VK_FORMAT_UNDEFINED 表示没有深度附件
+};
+
+/**
+ * @brief 无图片帧缓冲描述, 只记录附件图片的创建参数, 开始渲染通道时再传入图片视图
+ * 同一个帧缓冲可用于所有参数相同的图片 (例如交换链的每一张)
+ */
+struct GpuFramebufferDesc
+{
+    VkRenderPass render_pass = VK_NULL_HANDLE;  ///< 需来自 GetRenderPass, 兼容的渲染通道共用帧缓冲
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t layers = 1;
+    VkFormat color_format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags color_usage = 0;      ///< 需与图片创建时的用途一致
+    VkImageCreateFlags color_flags = 0;
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;    ///< 与渲染通道的深度附件一致
+    VkImageUsageFlags depth_usage = 0;
+};
+
+/**
+ * @brief 描述符集布局描述, 绑定按 binding 排序, 不支持不可变采样器
+ */
+struct GpuDescriptorSetLayoutDesc
+{
+    static constexpr uint32_t kMaxBindings = 16;
+
+    uint32_t binding_count = 0;
+    uint32_t reserved = 0;
+    std::array<VkDescriptorSetLayoutBinding, kMaxBindings> bindings{};
+};
+
+/**
+ * @brief 管线布局描述, 描述符集布局需来自 GetDescriptorSetLayout
+ */
+struct GpuPipelineLayoutDesc
+{
+    static constexpr uint32_t kMaxSets = 4;
+    static constexpr uint32_t kMaxPushConstants = 4;
+
+    uint32_t set_count = 0;
+    uint32_t push_constant_count = 0;
+    std::array<VkDescriptorSetLayout, kMaxSets> set_layouts{};
+    std::array<VkPushConstantRange, kMaxPushConstants> push_constants{};
+};
+
+/**
+ * @brief 管线状态对象库
+ * 渲染通道, 描述符集布局, 管线布局和管线都按内容哈希去重, 相同描述返回同一个对象, 查找为 O(1).
+ * 管线键用着色器内容哈希代替模块句柄, 用渲染通道的兼容类 (附件格式和采样数) 代替渲染通道句柄,
+ * 所以兼容的渲染通道之间共用管线. 无图片帧缓冲同样按兼容类和附件参数去重.
+ * 库拥有创建的所有对象, UnInit 时统一销毁.
+ * 调用方应在加载时取得句柄并保存, 绘制时直接使用句柄
+ */
+class GpuPipelineLibrary final
+{
+public:
+    GpuPipelineLibrary() = default;
+    ~GpuPipelineLibrary();
+
+    GpuPipelineLibrary(const GpuPipelineLibrary&) = delete;
+    GpuPipelineLibrary& operator=(const GpuPipelineLibrary&) = delete;
+
+    bool Init(VkDevice device, GpuPipelineCompiler* compiler);
+
+    /**
+     * @brief 等待编译中的管线并销毁全部对象
+     */
+    void UnInit();
+
+    VkRenderPass GetRenderPass(const GpuRenderPassDesc& desc);
+    VkDescriptorSetLayout GetDescriptorSetLayout(const GpuDescriptorSetLayoutDesc& desc);
+    VkPipelineLayout GetPipelineLayout(const GpuPipelineLayoutDesc& desc);
+
+    /**
+     * @brief 由反射得到的接口 (通常已合并所有阶段) 生成描述符集布局和管线布局
+     * 中间没有用到的 set 使用空布局, 接口相同的着色器得到同一个布局
+     */
+    VkPipelineLayout GetPipelineLayout(const GpuShaderReflection& reflection);
+
+    /**
+     * @brief 相同状态已存在时返回已有的句柄并增加引用, 否则提交编译
+     * desc.render_pass 需来自 GetRenderPass 或为空 (动态渲染), desc.layout 需来自 GetPipelineLayout
+     */
+    GpuPipelineHandle GetPipeline(const GraphicsPipelineDesc& desc);
+
+    /**
+     * @brief 减少引用, 归零时从库中移除, 返回需要调用方销毁的管线 (通常放入延迟释放队列)
+     * 仍有引用或编译失败时返回 VK_NULL_HANDLE. 调用前需保证编译已结束
+     */
+    VkPipeline ReleasePipeline(const GpuPipelineHandle& handle);
+
+    size_t PipelineCount();
+
+    /**
+     * @brief 取得无图片帧缓冲并增加引用, 需要设备开启 imagelessFramebuffer
+     */
+    VkFramebuffer GetFramebuffer(const GpuFramebufferDesc& desc);
+
+    /**
+     * @brief 减少引用, 归零时从库中移除, 返回需要调用方销毁的帧缓冲
+     */
+    VkFramebuffer ReleaseFramebuffer(VkFramebuffer framebuffer);
+
+private:
+    /**
+     * @brief 管线键, 没有填充, 按字节哈希和比较
+     */
+    struct PipelineKey
+    {
+        uint64_t vertex_hash = 0;
+        uint64_t fragment_hash = 0;
+        uint64_t layout = 0;            ///< 布局已去重, 句柄相同即内容相同
+        uint64_t render_pass_class = 0; ///< 渲染通道兼容类, 动态渲染时由附件格式得到
+        uint32_t subpass = 0;
+        uint32_t reserved = 0;
+        GpuPipelineState state;
+        GpuSpecialization vertex_constants;     ///< 特化常量不同的变体是不同的管线
+        GpuSpecialization fragment_constants;
+    };
+
+    struct RenderPassKey
+    {
+        VkFormat color_format;
+        VkSampleCountFlagBits samples;
+        VkAttachmentLoadOp load_op;
+        VkAttachmentStoreOp store_op;
+        VkImageLayout initial_layout;
+        VkImageLayout final_layout;
+        VkFormat depth_format;
+    };
+
+    struct FramebufferKey
+    {
+        uint64_t render_pass_class = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t layers = 0;
+        VkFormat color_format = VK_FORMAT_UNDEFINED;
+        VkImageUsageFlags color_usage = 0;
+        VkImageCreateFlags color_flags = 0;
+        VkFormat depth_format = VK_FORMAT_UNDEFINED;
+        VkImageUsageFlags depth_usage = 0;
+    };
+
+    /**
+     * @brief 键已经算好哈希, 这里直接取用
+     */
+    template <typename Key>
+    struct HashedKey
+    {
+        Key key;
+        uint64_t hash = 0;
+
+        bool operator==(const HashedKey& other) const
+        {
+            return hash == other.hash && std::memcmp(&key, &other.key, sizeof(Key)) == 0;
+        }
+    };
+
+    template <typename Key>
+    struct KeyHasher
+    {
+        size_t operator()(const HashedKey<Key>& key) const { return static_cast<size_t>(key.hash); }
+    };
+
+    template <typename Key, typename Value>
+    using KeyMap = std::unordered_map<HashedKey<Key>, Value, KeyHasher<Key>>;
+
+    struct PipelineEntry
+    {
+        GpuPipelineHandle handle;
+        uint32_t ref_count = 0;
+    };
+
+    struct FramebufferEntry
+    {
+        VkFramebuffer vk_framebuffer = VK_NULL_HANDLE;
+        uint32_t ref_count = 0;
+    };
+
+    VkRenderPass _CreateRenderPass(const GpuRenderPassDesc& desc);
+    VkFramebuffer _CreateFramebuffer(const GpuFramebufferDesc& desc);
+
+private:
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    GpuPipelineCompiler* compiler_ = nullptr;
+
+    std::mutex mutex_;
+    KeyMap<RenderPassKey, VkRenderPass> render_passes_;
+    std::unordered_map<VkRenderPass, uint64_t> render_pass_classes_;    ///< 渲染通道到兼容类
+    KeyMap<GpuDescriptorSetLayoutDesc, VkDescriptorSetLayout> set_layouts_;
+    KeyMap<GpuPipelineLayoutDesc, VkPipelineLayout> layouts_;
+    KeyMap<PipelineKey, PipelineEntry> pipelines_;
+    std::unordered_map<const GpuPipelineJob*, HashedKey<PipelineKey>> pipeline_keys_;   ///< 释放时由句柄找到键
+    KeyMap<FramebufferKey, FramebufferEntry> framebuffers_;
+    std::unordered_map<VkFramebuffer, HashedKey<FramebufferKey>> framebuffer_keys_;
+};
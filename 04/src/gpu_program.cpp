@@ -1,310 +1,811 @@
-#include "gpu_program.h"
-
-#include <fstream>
-#include <vector>
-#include <fmt/format.h>
-
-GpuProgram* GpuProgram::GetInstance()
-{
-    static GpuProgram obj;
-    return &obj;
-}
-
-bool GpuProgram::Init(SDL_Window* parent_window)
-{
-    vk_resource_ = std::make_unique<GpuResource>();
-    if (!vk_resource_->Init(parent_window))
-    {
-        vk_resource_.reset();
-        return false;
-    }
-
-    std::vector<char> vertex_shader = _ReadFile("shader/vert.spv");
-    std::vector<char> fragment_shader = _ReadFile("shader/frag.spv");
-
-    triangle_shader_ = std::make_unique<TriangleShader>(vk_resource_.get());
-    TriangleShader::ShaderParam param;
-    param.vertex_shader = std::move(vertex_shader);
-    param.pixel_shader = std::move(fragment_shader);
-    param.viewport = vk_resource_->vk_swapchain_image_extent;
-    if (!triangle_shader_->Init(param))
-    {
-        return false;
-    }
-
-    if (!_CreateFrameBuffer())
-    {
-        return false;
-    }
-
-    if (!_CreateCommandPool())
-    {
-        return false;
-    }
-
-    if (!_CreateCommandBuffer())
-    {
-        return false;
-    }
-
-    if (!_CreateSyncObjects())
-    {
-        return false;
-    }
-    return true;
-}
-
-void GpuProgram::Uninit()
-{
-    vkDeviceWaitIdle(vk_resource_->vk_device_);
-
-    if (vk_imageavailable_semaphore_ != VK_NULL_HANDLE)
-    {
-        vkDestroySemaphore(vk_resource_->vk_device_, vk_imageavailable_semaphore_, nullptr);
-        vk_imageavailable_semaphore_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_renderfinshed_semaphore_ != VK_NULL_HANDLE)
-    {
-        vkDestroySemaphore(vk_resource_->vk_device_, vk_renderfinshed_semaphore_, nullptr);
-        vk_renderfinshed_semaphore_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_inflight_fence_ != VK_NULL_HANDLE)
-    {
-        vkDestroyFence(vk_resource_->vk_device_, vk_inflight_fence_, nullptr);
-        vk_inflight_fence_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_commandpool_ != VK_NULL_HANDLE)
-    {
-        vkDestroyCommandPool(vk_resource_->vk_device_, vk_commandpool_, nullptr);
-        vk_commandpool_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_swapchain_framebuffers_.size() > 0)
-    {
-        for (auto& index : vk_swapchain_framebuffers_)
-        {
-            vkDestroyFramebuffer(vk_resource_->vk_device_, index, nullptr);
-        }
-        vk_swapchain_framebuffers_.clear();
-    }
-
-    if (vk_resource_)
-    {
-        vk_resource_.reset();
-    }
-}
-
-void GpuProgram::DrawFrame()
-{
-    // 等待新帧
-    vkWaitForFences(vk_resource_->vk_device_, 1, &vk_inflight_fence_, VK_TRUE, UINT64_MAX);
-    vkResetFences(vk_resource_->vk_device_, 1, &vk_inflight_fence_);
-
-    uint32_t imageIndex = 0;
-    vkAcquireNextImageKHR(vk_resource_->vk_device_,
-        vk_resource_->vk_swap_chain_, UINT64_MAX, vk_imageavailable_semaphore_, VK_NULL_HANDLE, &imageIndex);
-
-    vkResetCommandBuffer(vk_commandbuffer_, 0);
-    _RecordCommandBuffer(vk_commandbuffer_, imageIndex);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[] = { vk_imageavailable_semaphore_ };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &vk_commandbuffer_;
-
-    VkSemaphore signalSemaphores[] = { vk_renderfinshed_semaphore_ };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(vk_resource_->vk_graphics_queue_, 1, &submitInfo, vk_inflight_fence_) != VK_SUCCESS) {
-        fmt::print("vkQueueSubmit return error\n");
-        return;
-    }
-
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-
-    VkSwapchainKHR swapChains[] = { vk_resource_->vk_swap_chain_ };
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-
-    presentInfo.pImageIndices = &imageIndex;
-
-    vkQueuePresentKHR(vk_resource_->vk_present_queue_, &presentInfo);
-}   
-
-std::vector<char> GpuProgram::_ReadFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
-    }
-
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-
-    file.close();
-
-    return buffer;
-}
-
-bool GpuProgram::_CreateFrameBuffer()
-{    
-    for (uint32_t i = 0; i < vk_resource_->vk_swapchain_image_views.size(); i++)
-    {
-        VkFramebuffer frame_buffer;
-
-        std::vector<VkImageView> attachments = { vk_resource_->vk_swapchain_image_views[i] };
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = triangle_shader_->vk_render_pass_;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.height = vk_resource_->vk_swapchain_image_extent.height;
-        framebufferInfo.width = vk_resource_->vk_swapchain_image_extent.width;
-        framebufferInfo.layers = 1;
-
-        VkResult result = vkCreateFramebuffer(vk_resource_->vk_device_, &framebufferInfo, nullptr, &frame_buffer);
-        if (result != VK_SUCCESS)
-        {
-            return false;
-        }
-        vk_swapchain_framebuffers_.push_back(frame_buffer);
-    }
-
-    return true;
-}
-
-bool GpuProgram::_CreateCommandPool()
-{
-    VkCommandPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    poolInfo.queueFamilyIndex = vk_resource_->vk_graphics_family_;
-    poolInfo.pNext = nullptr;
-
-    VkResult ret = vkCreateCommandPool(vk_resource_->vk_device_, &poolInfo, nullptr, &vk_commandpool_);
-    if (ret != VK_SUCCESS)
-    {
-        fmt::print("vkCreateCommandPool return error: {} \n", ret);
-        return false;
-    }
-
-    return true;
-}
-
-bool GpuProgram::_CreateCommandBuffer()
-{
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = vk_commandpool_;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
-    allocInfo.pNext = nullptr;
-
-    VkResult result = vkAllocateCommandBuffers(vk_resource_->vk_device_, &allocInfo, &vk_commandbuffer_);
-    if (result != VK_SUCCESS)
-    {
-        fmt::print("vkAllocateCommandBuffers return error: {}\n", result);
-        return false;
-    }
-    return true;
-}
-
-void GpuProgram::_RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
-{
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-    VkResult ret = vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    if (ret != VK_SUCCESS)
-    {
-        fmt::print("vkBeginCommandBuffer return error: {}\n", ret);
-    }
-
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = triangle_shader_->vk_render_pass_;
-    renderPassInfo.framebuffer = vk_swapchain_framebuffers_[imageIndex];
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = vk_resource_->vk_swapchain_image_extent;
-
-    VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle_shader_->vk_graphics_pipeline_);
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(vk_resource_->vk_swapchain_image_extent.width);
-    viewport.height = static_cast<float>(vk_resource_->vk_swapchain_image_extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = vk_resource_->vk_swapchain_image_extent;
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-
-    vkCmdEndRenderPass(commandBuffer);
-
-    ret = vkEndCommandBuffer(commandBuffer);
-    if (ret != VK_SUCCESS)
-    {
-        fmt::print("vkEndCommandBuffer return error: {} \n", ret);
-    }
-}
-
-bool GpuProgram::_CreateSyncObjects()
-{
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    VkResult ret = vkCreateSemaphore(vk_resource_->vk_device_, &semaphoreInfo, nullptr, &vk_imageavailable_semaphore_);
-    if (ret != VK_SUCCESS)
-    {
-        fmt::print("vkCreateSemaphore return error: {} \n", ret);
-        return false;
-    }
-
-    ret = vkCreateSemaphore(vk_resource_->vk_device_, &semaphoreInfo, nullptr, &vk_renderfinshed_semaphore_);
-    if (ret != VK_SUCCESS)
-    {
-        fmt::print("vkCreateSemaphore return error: {} \n", ret);
-        return false;
-    }
-
-    ret = vkCreateFence(vk_resource_->vk_device_, &fenceInfo, nullptr, &vk_inflight_fence_);
-    if (ret != VK_SUCCESS)
-    {
-        fmt::print("vkCreateFence return error: {}\n", ret);
-        return false;
-    }
-    return true;
+#include "gpu_program.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+#include <fmt/format.h>
+#include "gpu_host_allocator.h"
+#ifdef VULKAN_APP_EMBED_SHADERS
+#include "embedded_shaders.h"
+#endif
+
+GpuProgram* GpuProgram::GetInstance()
+{
+    static GpuProgram obj;
+    return &obj;
+}
+
+bool GpuProgram::Init(SDL_Window* parent_window, const GpuConfig& config)
+{
+    frames_.resize(std::clamp(config.frames_in_flight, 1u, kMaxFramesInFlight));
+    current_frame_ = 0;
+    headless_image_index_ = 0;
+
+    vk_resource_ = std::make_unique<GpuResource>();
+    if (!vk_resource_->Init(parent_window, config))
+    {
+        vk_resource_.reset();
+        return false;
+    }
+
+    triangle_shader_ = std::make_unique<TriangleShader>(vk_resource_.get());
+    TriangleShader::ShaderParam param;
+    param.vertex_shader = "shader/vert.spv";
+    param.pixel_shader = "shader/frag.spv";
+#ifdef VULKAN_APP_EMBED_SHADERS
+    // 构建时编译并嵌入的着色器, 启动时不读文件, 不会用到旧的 .spv
+    param.vertex_embedded = &kEmbeddedShaderVert;
+    param.pixel_embedded = &kEmbeddedShaderFrag;
+#endif
+    // 对应 shader.frag 中的 constant_id = 0, 不同取值是不同的管线
+    param.pixel_constants.SetFloat(0, config.brightness);
+    if (!triangle_shader_->Init(param))
+    {
+        return false;
+    }
+
+    if (config.shader_hot_reload)
+    {
+        shader_watcher_.Init(config.shader_compiler, [this](const std::string& path) {
+            triangle_shader_->OnShaderChanged(path);
+        });
+        shader_watcher_.Watch(param.vertex_shader, "shader/shader.vert");
+        shader_watcher_.Watch(param.pixel_shader, "shader/shader.frag");
+    }
+
+    if (!_CreateFrameBuffer())
+    {
+        return false;
+    }
+
+    if (!_CreateCommandPool())
+    {
+        return false;
+    }
+
+    if (!_CreateCommandBuffer())
+    {
+        return false;
+    }
+
+    if (!_CreateSyncObjects())
+    {
+        return false;
+    }
+
+    if (!_CreateFrameAllocators(config.frame_allocator_size))
+    {
+        return false;
+    }
+    return true;
+}
+
+void GpuProgram::Uninit()
+{
+    if (!vk_resource_)
+    {
+        return;
+    }
+    // 先停止监视线程, 之后不会再有重载请求
+    shader_watcher_.UnInit();
+    vkDeviceWaitIdle(vk_resource_->vk_device_);
+
+    for (auto& frame : frames_)
+    {
+        if (frame.vk_imageavailable_semaphore != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(vk_resource_->vk_device_, frame.vk_imageavailable_semaphore, GpuHostCallbacks());
+            frame.vk_imageavailable_semaphore = VK_NULL_HANDLE;
+        }
+
+        // 命令缓冲随命令池一起释放
+        frame.vk_commandbuffer = VK_NULL_HANDLE;
+        frame.frame_allocator.UnInit();
+    }
+    frames_.clear();
+
+    for (auto& index : vk_renderfinshed_semaphores_)
+    {
+        vkDestroySemaphore(vk_resource_->vk_device_, index, GpuHostCallbacks());
+    }
+    vk_renderfinshed_semaphores_.clear();
+    images_inflight_values_.clear();
+
+    if (vk_commandpool_ != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(vk_resource_->vk_device_, vk_commandpool_, GpuHostCallbacks());
+        vk_commandpool_ = VK_NULL_HANDLE;
+    }
+
+    _ReleaseImagelessFramebuffer();
+    if (vk_swapchain_framebuffers_.size() > 0)
+    {
+        for (auto& index : vk_swapchain_framebuffers_)
+        {
+            vkDestroyFramebuffer(vk_resource_->vk_device_, index, GpuHostCallbacks());
+        }
+        vk_swapchain_framebuffers_.clear();
+    }
+
+    // 管线依赖设备, 需要在设备之前释放
+    triangle_shader_.reset();
+
+    if (vk_resource_)
+    {
+        vk_resource_.reset();
+    }
+}
+
+void GpuProgram::WaitPipelines()
+{
+    if (vk_resource_)
+    {
+        vk_resource_->pipeline_compiler_.WaitIdle();
+    }
+}
+
+bool GpuProgram::CheckUploads()
+{
+    constexpr VkDeviceSize kCheckSize = 64 << 10;
+    GpuAllocator& allocator = vk_resource_->allocator_;
+    GpuUploadEngine& upload_engine = vk_resource_->upload_engine_;
+    GpuTimeline& timeline = vk_resource_->graphics_timeline_;
+
+    // 前半段经暂存环, 后半段经上传引擎
+    std::vector<uint32_t> pattern(kCheckSize * 2 / sizeof(uint32_t));
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        pattern[i] = static_cast<uint32_t>(i) * 2654435761u ^ 0x5a5aa5a5u;
+    }
+
+    GpuBuffer target;
+    GpuBuffer readback;
+    if (!allocator.CreateBuffer(kCheckSize * 2, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            GpuMemoryUsage::kDeviceOnly, target)
+        || !allocator.CreateBuffer(kCheckSize * 2, VK_BUFFER_USAGE_TRANSFER_DST_BIT, GpuMemoryUsage::kReadback, readback))
+    {
+        allocator.DestroyBuffer(target);
+        return false;
+    }
+
+    bool result = false;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    do
+    {
+        uint64_t ticket = upload_engine.UploadBuffer(pattern.data() + pattern.size() / 2, kCheckSize, target.vk_buffer,
+            kCheckSize, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        if (ticket == 0 || upload_engine.Submit() == 0)
+        {
+            fmt::print("upload check: upload engine failed\n");
+            break;
+        }
+
+        GpuStagingRegion region;
+        if (!vk_resource_->staging_ring_.Allocate(kCheckSize, 4, region))
+        {
+            fmt::print("upload check: staging ring is full\n");
+            break;
+        }
+        memcpy(region.mapped, pattern.data(), static_cast<size_t>(kCheckSize));
+        vk_resource_->staging_ring_.Flush(region);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = vk_commandpool_;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(vk_resource_->vk_device_, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            break;
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkPipelineStageFlags upload_wait_stage = 0;
+        uint64_t upload_wait_value = upload_engine.RecordAcquireBarriers(commandBuffer, upload_wait_stage);
+
+        VkBufferCopy copy{};
+        copy.srcOffset = region.offset;
+        copy.dstOffset = 0;
+        copy.size = kCheckSize;
+        vkCmdCopyBuffer(commandBuffer, region.vk_buffer, target.vk_buffer, 1, &copy);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+
+        copy.srcOffset = 0;
+        copy.size = kCheckSize * 2;
+        vkCmdCopyBuffer(commandBuffer, target.vk_buffer, readback.vk_buffer, 1, &copy);
+
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(commandBuffer);
+
+        uint64_t signal_value = timeline.NextValue();
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = upload_wait_value != 0 ? 1 : 0;
+        timelineInfo.pWaitSemaphoreValues = &upload_wait_value;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signal_value;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = timelineInfo.waitSemaphoreValueCount;
+        submitInfo.pWaitSemaphores = &upload_engine.timeline_.vk_semaphore_;
+        submitInfo.pWaitDstStageMask = &upload_wait_stage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &timeline.vk_semaphore_;
+        if (vkQueueSubmit(vk_resource_->vk_graphics_queue_, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            fmt::print("upload check: vkQueueSubmit return error\n");
+            break;
+        }
+        vk_resource_->staging_ring_.Retire(signal_value);
+        timeline.Wait(signal_value);
+
+        if (!(readback.allocation.property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        {
+            // 子分配的偏移不一定按 atom 对齐, 失效范围取整个内存对象
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = readback.allocation.vk_memory;
+            range.offset = 0;
+            range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(vk_resource_->vk_device_, 1, &range);
+        }
+
+        const uint8_t* expected = reinterpret_cast<const uint8_t*>(pattern.data());
+        const uint8_t* actual = static_cast<const uint8_t*>(readback.allocation.mapped);
+        result = true;
+        for (VkDeviceSize i = 0; i < kCheckSize * 2; i++)
+        {
+            if (expected[i] != actual[i])
+            {
+                fmt::print("upload check: {} mismatch at byte {}\n", i < kCheckSize ? "staging ring" : "upload engine", i);
+                result = false;
+                break;
+            }
+        }
+    } while (false);
+
+    // 失败时可能仍有提交在执行
+    vkDeviceWaitIdle(vk_resource_->vk_device_);
+    if (commandBuffer != VK_NULL_HANDLE)
+    {
+        vkFreeCommandBuffers(vk_resource_->vk_device_, vk_commandpool_, 1, &commandBuffer);
+    }
+    allocator.DestroyBuffer(readback);
+    allocator.DestroyBuffer(target);
+
+    if (result)
+    {
+        fmt::print("upload check: {} bytes through staging ring and upload engine ({} queue) verified\n",
+            kCheckSize * 2, upload_engine.HasDedicatedQueue() ? "transfer" : "graphics");
+    }
+    return result;
+}
+
+void GpuProgram::DrawFrame()
+{
+    FrameContext& frame = frames_[current_frame_];
+    GpuTimeline& timeline = vk_resource_->graphics_timeline_;
+
+    // 回收 GPU 已经用完的旧资源和暂存空间
+    uint64_t completed_value = timeline.CompletedValue();
+    vk_resource_->deletion_queue_.Collect(completed_value);
+    vk_resource_->staging_ring_.Reclaim(completed_value);
+    vk_resource_->residency_.Update(completed_value);
+    // 离屏图片被驱逐后重建, 引用旧图片视图的帧缓冲随交换链资源一起重建
+    if (vk_resource_->TakeRenderTargetsChanged())
+    {
+        swapchain_dirty_ = true;
+    }
+    vk_resource_->pipeline_cache_.Update();
+    // 帧边界: 重新编译好的管线在这里切换, 本帧开始使用
+    triangle_shader_->Update();
+
+    if (swapchain_dirty_)
+    {
+        if (!_RecreateSwapChain())
+        {
+            // 窗口最小化, 跳过该帧, 下一帧继续尝试
+            return;
+        }
+        swapchain_dirty_ = false;
+    }
+
+    // 只等待环里最早的那一帧, 其余帧仍可在 GPU 上执行; timeline 无需重置
+    timeline.Wait(frame.timeline_value);
+
+    bool headless = vk_resource_->IsHeadless();
+    uint32_t imageIndex = 0;
+    if (headless)
+    {
+        // 离屏图片按顺序轮流使用
+        imageIndex = headless_image_index_;
+        headless_image_index_ = (headless_image_index_ + 1) % static_cast<uint32_t>(images_inflight_values_.size());
+    }
+    else {
+        VkResult ret = vkAcquireNextImageKHR(vk_resource_->vk_device_,
+            vk_resource_->vk_swap_chain_, UINT64_MAX, frame.vk_imageavailable_semaphore, VK_NULL_HANDLE, &imageIndex);
+        if (ret == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // 信号量未被 signal, 直接重建后在下一帧重新获取
+            swapchain_dirty_ = true;
+            return;
+        }
+        else if (ret == VK_SUBOPTIMAL_KHR) {
+            // 图片已获取, 继续绘制本帧, 下一帧重建
+            swapchain_dirty_ = true;
+        }
+        else if (ret != VK_SUCCESS) {
+            fmt::print("vkAcquireNextImageKHR return error: {}\n", ret);
+            return;
+        }
+    }
+
+    // 图片可能仍被更早的帧使用 (帧数多于交换链图片数时)
+    timeline.Wait(images_inflight_values_[imageIndex]);
+    frame.scratch.clear();
+    // 上一轮使用该帧上下文的提交已完成, 整块回收
+    frame.frame_allocator.Reset();
+
+    // 先提交排队的上传, 本帧录制时 acquire
+    GpuUploadEngine& upload_engine = vk_resource_->upload_engine_;
+    upload_engine.Submit();
+
+    vkResetCommandBuffer(frame.vk_commandbuffer, 0);
+    _RecordCommandBuffer(frame, imageIndex);
+    frame.frame_allocator.Flush();
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    // 无窗口模式没有 acquire/present, 只需要 signal timeline
+    uint32_t binary_count = headless ? 0 : 1;
+    VkSemaphore waitSemaphores[2] = {};
+    VkPipelineStageFlags waitStages[2] = {};
+    uint64_t waitValues[2] = {};
+    uint32_t wait_count = 0;
+    if (!headless)
+    {
+        waitSemaphores[wait_count] = frame.vk_imageavailable_semaphore;
+        waitStages[wait_count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        wait_count++;
+    }
+    // 独立传输队列上的上传需要先完成 release, acquire 屏障才能生效
+    if (frame.upload_wait_value != 0)
+    {
+        waitSemaphores[wait_count] = upload_engine.timeline_.vk_semaphore_;
+        waitStages[wait_count] = frame.upload_wait_stage;
+        waitValues[wait_count] = frame.upload_wait_value;
+        wait_count++;
+    }
+    submitInfo.waitSemaphoreCount = wait_count;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.vk_commandbuffer;
+
+    // 二值信号量给 present 使用, timeline 记录帧完成进度
+    uint64_t signal_value = timeline.NextValue();
+    VkSemaphore signalSemaphores[] = { timeline.vk_semaphore_, 
+        headless ? VK_NULL_HANDLE : vk_renderfinshed_semaphores_[imageIndex] };
+    uint64_t signalValues[] = { signal_value, 0 };
+    submitInfo.signalSemaphoreCount = 1 + binary_count;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = wait_count;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 1 + binary_count;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+
+    if (vkQueueSubmit(vk_resource_->vk_graphics_queue_, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        fmt::print("vkQueueSubmit return error\n");
+        return;
+    }
+    frame.timeline_value = signal_value;
+    vk_resource_->staging_ring_.Retire(signal_value);
+    vk_resource_->TouchRenderTarget(imageIndex, signal_value);
+    images_inflight_values_[imageIndex] = signal_value;
+    current_frame_ = (current_frame_ + 1) % static_cast<uint32_t>(frames_.size());
+
+    if (headless)
+    {
+        return;
+    }
+
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &signalSemaphores[1];
+
+    VkSwapchainKHR swapChains[] = { vk_resource_->vk_swap_chain_ };
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = swapChains;
+
+    presentInfo.pImageIndices = &imageIndex;
+
+    VkResult ret = vkQueuePresentKHR(vk_resource_->vk_present_queue_, &presentInfo);
+    if (ret == VK_ERROR_OUT_OF_DATE_KHR || ret == VK_SUBOPTIMAL_KHR)
+    {
+        swapchain_dirty_ = true;
+    }
+    else if (ret != VK_SUCCESS) {
+        fmt::print("vkQueuePresentKHR return error: {}\n", ret);
+    }
+}
+
+void GpuProgram::OnResize()
+{
+    swapchain_dirty_ = true;
+}
+
+void GpuProgram::SetPresentProfile(PresentProfile profile)
+{
+    if (!vk_resource_ || vk_resource_->GetPresentProfile() == profile)
+    {
+        return;
+    }
+    vk_resource_->SetPresentProfile(profile);
+    swapchain_dirty_ = true;
+}   
+
+bool GpuProgram::_CreateFrameBuffer()
+{    
+    // 动态渲染直接使用图片视图, 不需要帧缓冲
+    if (vk_resource_->UseDynamicRendering())
+    {
+        return true;
+    }
+
+    // 帧缓冲只记录图片参数, 开始渲染通道时再传入图片视图. 重建交换链时只需要一个
+    if (vk_resource_->UseImagelessFramebuffer())
+    {
+        GpuFramebufferDesc desc;
+        desc.render_pass = triangle_shader_->vk_render_pass_;
+        desc.width = vk_resource_->vk_swapchain_image_extent.width;
+        desc.height = vk_resource_->vk_swapchain_image_extent.height;
+        desc.color_format = vk_resource_->vk_swapchain_image_format;
+        desc.color_usage = vk_resource_->vk_swapchain_image_usage_;
+        vk_imageless_framebuffer_ = vk_resource_->pipeline_library_.GetFramebuffer(desc);
+        return vk_imageless_framebuffer_ != VK_NULL_HANDLE;
+    }
+
+    vk_swapchain_framebuffers_.reserve(vk_resource_->vk_swapchain_image_views.size());
+    for (uint32_t i = 0; i < vk_resource_->vk_swapchain_image_views.size(); i++)
+    {
+        VkFramebuffer frame_buffer;
+
+        std::array<VkImageView, 1> attachments = { vk_resource_->vk_swapchain_image_views[i] };
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = triangle_shader_->vk_render_pass_;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.height = vk_resource_->vk_swapchain_image_extent.height;
+        framebufferInfo.width = vk_resource_->vk_swapchain_image_extent.width;
+        framebufferInfo.layers = 1;
+
+        VkResult result = vkCreateFramebuffer(vk_resource_->vk_device_, &framebufferInfo, GpuHostCallbacks(), &frame_buffer);
+        if (result != VK_SUCCESS)
+        {
+            return false;
+        }
+        vk_swapchain_framebuffers_.push_back(frame_buffer);
+    }
+
+    return true;
+}
+
+bool GpuProgram::_CreateCommandPool()
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = vk_resource_->vk_graphics_family_;
+    poolInfo.pNext = nullptr;
+
+    VkResult ret = vkCreateCommandPool(vk_resource_->vk_device_, &poolInfo, GpuHostCallbacks(), &vk_commandpool_);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateCommandPool return error: {} \n", ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool GpuProgram::_CreateCommandBuffer()
+{
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = vk_commandpool_;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(frames_.size());
+    allocInfo.pNext = nullptr;
+
+    std::vector<VkCommandBuffer> command_buffers(frames_.size());
+    VkResult result = vkAllocateCommandBuffers(vk_resource_->vk_device_, &allocInfo, command_buffers.data());
+    if (result != VK_SUCCESS)
+    {
+        fmt::print("vkAllocateCommandBuffers return error: {}\n", result);
+        return false;
+    }
+
+    for (size_t i = 0; i < frames_.size(); i++)
+    {
+        frames_[i].vk_commandbuffer = command_buffers[i];
+    }
+    return true;
+}
+
+bool GpuProgram::_CreateFrameAllocators(VkDeviceSize size)
+{
+    for (auto& frame : frames_)
+    {
+        if (!frame.frame_allocator.Init(&vk_resource_->allocator_, size, vk_resource_->GetLimits()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void GpuProgram::_RecordCommandBuffer(FrameContext& frame, uint32_t imageIndex)
+{
+    VkCommandBuffer commandBuffer = frame.vk_commandbuffer;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    VkResult ret = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkBeginCommandBuffer return error: {}\n", ret);
+    }
+
+    // 接收传输队列交出的 buffer 所有权
+    frame.upload_wait_value = vk_resource_->upload_engine_.RecordAcquireBarriers(commandBuffer, frame.upload_wait_stage);
+
+    _BeginRendering(commandBuffer, imageIndex);
+
+    // 管线还在后台编译时只清屏, 不阻塞渲染线程
+    VkPipeline pipeline = triangle_shader_->GetPipeline();
+    if (pipeline != VK_NULL_HANDLE)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(vk_resource_->vk_swapchain_image_extent.width);
+        viewport.height = static_cast<float>(vk_resource_->vk_swapchain_image_extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = vk_resource_->vk_swapchain_image_extent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    }
+
+    _EndRendering(commandBuffer, imageIndex);
+
+    ret = vkEndCommandBuffer(commandBuffer);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkEndCommandBuffer return error: {} \n", ret);
+    }
+}
+
+void GpuProgram::_BeginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+
+    if (!vk_resource_->UseDynamicRendering())
+    {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = triangle_shader_->vk_render_pass_;
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = vk_resource_->vk_swapchain_image_extent;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+
+        VkRenderPassAttachmentBeginInfo attachmentInfo{};
+        attachmentInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO;
+        attachmentInfo.attachmentCount = 1;
+        attachmentInfo.pAttachments = &vk_resource_->vk_swapchain_image_views[imageIndex];
+        if (vk_imageless_framebuffer_ != VK_NULL_HANDLE)
+        {
+            renderPassInfo.pNext = &attachmentInfo;
+            renderPassInfo.framebuffer = vk_imageless_framebuffer_;
+        }
+        else {
+            renderPassInfo.framebuffer = vk_swapchain_framebuffers_[imageIndex];
+        }
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    // 没有渲染通道的布局转换, 自己插入屏障. 旧内容会被清除, 从 UNDEFINED 转换即可
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = vk_resource_->vk_swapchain_images_[imageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    // 与获取图片的信号量等待在同一阶段, 保证呈现引擎读完后才写入
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = vk_resource_->vk_swapchain_image_views[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearColor;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.offset = { 0, 0 };
+    renderingInfo.renderArea.extent = vk_resource_->vk_swapchain_image_extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+
+    vk_resource_->vk_cmd_begin_rendering_(commandBuffer, &renderingInfo);
+}
+
+void GpuProgram::_EndRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    if (!vk_resource_->UseDynamicRendering())
+    {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
+
+    vk_resource_->vk_cmd_end_rendering_(commandBuffer);
+
+    // 转换到呈现或回读需要的布局, 之后的使用由信号量同步
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = vk_resource_->vk_target_layout_;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = vk_resource_->vk_swapchain_images_[imageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+bool GpuProgram::_CreateSyncObjects()
+{
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (auto& frame : frames_)
+    {
+        VkResult ret = vkCreateSemaphore(vk_resource_->vk_device_, &semaphoreInfo, GpuHostCallbacks(), &frame.vk_imageavailable_semaphore);
+        if (ret != VK_SUCCESS)
+        {
+            fmt::print("vkCreateSemaphore return error: {} \n", ret);
+            return false;
+        }
+        frame.timeline_value = 0;
+    }
+
+    return _CreatePresentSemaphores();
+}
+
+bool GpuProgram::_CreatePresentSemaphores()
+{
+    size_t image_count = vk_resource_->vk_swapchain_images_.size();
+    if (vk_resource_->IsHeadless())
+    {
+        // 离屏图片重建时不换新, 仍可能被已提交的帧使用, 保留它们的 timeline 值
+        images_inflight_values_.resize(image_count, 0);
+        return true;
+    }
+    images_inflight_values_.assign(image_count, 0);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    vk_renderfinshed_semaphores_.resize(image_count, VK_NULL_HANDLE);
+    for (auto& index : vk_renderfinshed_semaphores_)
+    {
+        VkResult ret = vkCreateSemaphore(vk_resource_->vk_device_, &semaphoreInfo, GpuHostCallbacks(), &index);
+        if (ret != VK_SUCCESS)
+        {
+            fmt::print("vkCreateSemaphore return error: {} \n", ret);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GpuProgram::_RecreateSwapChain()
+{
+    // 不调用 vkDeviceWaitIdle, 仍在执行的帧继续使用旧资源
+    if (!vk_resource_->RecreateSwapChain())
+    {
+        return false;
+    }
+
+    _RetireSwapChainResources();
+    if (!_CreateFrameBuffer())
+    {
+        return false;
+    }
+    return _CreatePresentSemaphores();
+}
+
+void GpuProgram::_ReleaseImagelessFramebuffer()
+{
+    if (vk_imageless_framebuffer_ == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    // 其他通道仍在使用同样参数的帧缓冲时只减少引用, 归零时和逐图片的帧缓冲一起销毁
+    VkFramebuffer framebuffer = vk_resource_->pipeline_library_.ReleaseFramebuffer(vk_imageless_framebuffer_);
+    if (framebuffer != VK_NULL_HANDLE)
+    {
+        vk_swapchain_framebuffers_.push_back(framebuffer);
+    }
+    vk_imageless_framebuffer_ = VK_NULL_HANDLE;
+}
+
+void GpuProgram::_RetireSwapChainResources()
+{
+    // 旧帧缓冲和呈现信号量可能仍被已提交的帧或 present 使用, 与旧交换链同批释放
+    uint64_t retire_value = vk_resource_->graphics_timeline_.PendingValue() + 1;
+    VkDevice device = vk_resource_->vk_device_;
+    _ReleaseImagelessFramebuffer();
+    vk_resource_->deletion_queue_.Push(retire_value, 
+        [device, framebuffers = std::move(vk_swapchain_framebuffers_), semaphores = std::move(vk_renderfinshed_semaphores_)]() {
+        for (auto& index : framebuffers)
+        {
+            vkDestroyFramebuffer(device, index, GpuHostCallbacks());
+        }
+        for (auto& index : semaphores)
+        {
+            vkDestroySemaphore(device, index, GpuHostCallbacks());
+        }
+    });
+    vk_swapchain_framebuffers_.clear();
+    vk_renderfinshed_semaphores_.clear();
 }
\ No newline at end of file
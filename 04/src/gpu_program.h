@@ -1,38 +1,107 @@
-#pragma once
-
-#include <memory>
-#include <vector>
-#include <vulkan/vulkan.hpp>
-#include "gpu_resource.h"
-#include "triangle_shader.h"
-
-class GpuProgram
-{
-public:
-    ~GpuProgram() = default;
-    static GpuProgram* GetInstance();
-    bool Init(SDL_Window* parent_window);
-    void Uninit();
-    void DrawFrame();
-
-private:
-    std::vector<char> _ReadFile(const std::string& filename);
-    bool _CreateFrameBuffer();
-    bool _CreateCommandPool();
-    bool _CreateCommandBuffer();
-    void _RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-    bool _CreateSyncObjects();
-
-private:
-    std::unique_ptr<GpuResource> vk_resource_ = nullptr;
-    std::unique_ptr<TriangleShader> triangle_shader_ = nullptr;
-    std::vector<VkFramebuffer> vk_swapchain_framebuffers_;
-
-    VkCommandPool vk_commandpool_ = VK_NULL_HANDLE;
-    VkCommandBuffer vk_commandbuffer_ = VK_NULL_HANDLE;
-
-    // 创建信号量
-    VkSemaphore vk_imageavailable_semaphore_ = VK_NULL_HANDLE;
-    VkSemaphore vk_renderfinshed_semaphore_ = VK_NULL_HANDLE;
-    VkFence vk_inflight_fence_ = VK_NULL_HANDLE;
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "gpu_frame_allocator.h"
+#include "gpu_resource.h"
+#include "gpu_shader_watcher.h"
+#include "triangle_shader.h"
+
+/**
+ * @brief 单帧录制上下文, 多个上下文组成环形队列轮流使用
+ * CPU 录制第 N+1 帧时, GPU 可以同时执行第 N 帧
+ */
+struct FrameContext
+{
+    VkCommandBuffer vk_commandbuffer = VK_NULL_HANDLE;
+    VkSemaphore vk_imageavailable_semaphore = VK_NULL_HANDLE;   ///< 交换链图片可用
+    uint64_t timeline_value = 0;    ///< 该帧提交 signal 的图形队列 timeline 值
+    std::vector<uint8_t> scratch;   ///< 帧内临时数据, 复用时只清空不释放
+    GpuFrameAllocator frame_allocator;  ///< 帧内 GPU 临时数据 (uniform, 动态顶点, indirect 参数)
+    uint64_t upload_wait_value = 0; ///< 本帧需要等待的上传 timeline 值, 0 表示不等待
+    VkPipelineStageFlags upload_wait_stage = 0;
+};
+
+class GpuProgram
+{
+public:
+    static constexpr uint32_t kMaxFramesInFlight = 8;
+
+public:
+    ~GpuProgram() = default;
+    static GpuProgram* GetInstance();
+    /**
+     * @brief 初始化渲染程序
+     * @param parent_window 窗口, config.headless 为 true 时可以为空
+     */
+    bool Init(SDL_Window* parent_window, const GpuConfig& config);
+    void Uninit();
+    void DrawFrame();
+
+    /**
+     * @brief 窗口大小变化, 下一帧开始前重建交换链
+     */
+    void OnResize();
+
+    /**
+     * @brief 运行时切换呈现策略, 下一帧通过重建交换链生效. 只能在渲染线程调用
+     */
+    void SetPresentProfile(PresentProfile profile);
+
+    /**
+     * @brief 当前正在录制的帧的线性分配器, 只在 DrawFrame 录制期间有效
+     */
+    GpuFrameAllocator& CurrentFrameAllocator() { return frames_[current_frame_].frame_allocator; }
+
+    /**
+     * @brief 等待后台编译的管线全部完成
+     */
+    void WaitPipelines();
+
+    /**
+     * @brief 分别经帧内暂存环和异步上传引擎上传已知数据, 拷贝回读后逐字节比较
+     * 只能在开始绘制前调用, 会等待 GPU 完成
+     */
+    bool CheckUploads();
+
+private:
+    bool _CreateFrameBuffer();
+    bool _CreateCommandPool();
+    bool _CreateCommandBuffer();
+    void _RecordCommandBuffer(FrameContext& frame, uint32_t imageIndex);
+    /**
+     * @brief 动态渲染时插入布局转换并直接开始渲染, 否则开始渲染通道
+     */
+    void _BeginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void _EndRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    bool _CreateSyncObjects();
+    bool _CreatePresentSemaphores();
+    bool _CreateFrameAllocators(VkDeviceSize size);
+
+    // 交换链重建, 旧的帧缓冲和信号量延迟释放
+    bool _RecreateSwapChain();
+    void _RetireSwapChainResources();
+    void _ReleaseImagelessFramebuffer();
+
+private:
+    std::unique_ptr<GpuResource> vk_resource_ = nullptr;
+    std::unique_ptr<TriangleShader> triangle_shader_ = nullptr;
+    GpuShaderWatcher shader_watcher_;   ///< 着色器热重载, 回调在监视线程上执行
+    std::vector<VkFramebuffer> vk_swapchain_framebuffers_;  ///< 不支持无图片帧缓冲时每张图片一个
+    VkFramebuffer vk_imageless_framebuffer_ = VK_NULL_HANDLE;   ///< 所有交换链图片共用, 管线库所有
+
+    VkCommandPool vk_commandpool_ = VK_NULL_HANDLE;
+
+    // 帧上下文环
+    std::vector<FrameContext> frames_;
+    uint32_t current_frame_ = 0;
+
+    // 呈现信号量按交换链图片分配, present 结束前同一张图片不会被再次获取, 可以安全复用
+    std::vector<VkSemaphore> vk_renderfinshed_semaphores_;
+    // 记录每张交换链图片最后一次被使用时的 timeline 值
+    std::vector<uint64_t> images_inflight_values_;
+    // 无窗口模式下轮流使用的离屏图片序号
+    uint32_t headless_image_index_ = 0;
+    bool swapchain_dirty_ = false;  ///< 交换链需要重建
 };
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "gpu_residency.h"
+
+#include <algorithm>
+#include <vector>
+#include <fmt/format.h>
+#include "gpu_allocator.h"
+
+bool GpuResidency::Init(VkInstance instance, VkPhysicalDevice physical_device, GpuAllocator* allocator, bool budget_extension)
+{
+    vk_physicaldevice_ = physical_device;
+    allocator_ = allocator;
+    budget_extension_ = budget_extension;
+    if (budget_extension_)
+    {
+        // 1.1 核心函数, 旧的实例只有 KHR 版本
+        PFN_vkVoidFunction func = vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2");
+        if (func == nullptr)
+        {
+            func = vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        }
+        vk_get_memory_properties2_ = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(func);
+        budget_extension_ = vk_get_memory_properties2_ != nullptr;
+    }
+
+    const VkPhysicalDeviceMemoryProperties& memory_properties = allocator_->GetMemoryProperties();
+    heap_count_ = memory_properties.memoryHeapCount;
+    for (uint32_t i = 0; i < heap_count_; i++)
+    {
+        heaps_[i] = GpuHeapBudget{};
+        heaps_[i].size = memory_properties.memoryHeaps[i].size;
+        over_budget_reported_[i] = false;
+    }
+    frame_counter_ = 0;
+    _QueryBudget();
+
+    fmt::print("memory budget: {}\n", budget_extension_ ? "VK_EXT_memory_budget" : "80% of heap size");
+    return true;
+}
+
+void GpuResidency::UnInit()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& lru : lru_)
+    {
+        lru.clear();
+    }
+    entries_.clear();
+    allocator_ = nullptr;
+}
+
+void GpuResidency::Update(uint64_t completed_value)
+{
+    std::vector<EvictCallback> victims;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (++frame_counter_ >= kQueryInterval)
+        {
+            frame_counter_ = 0;
+            _QueryBudget();
+        }
+
+        for (uint32_t heap = 0; heap < heap_count_; heap++)
+        {
+            VkDeviceSize budget = heaps_[heap].budget;
+            VkDeviceSize usage = _EstimatedUsage(heap);
+            if (usage <= static_cast<VkDeviceSize>(budget * kHighWater))
+            {
+                over_budget_reported_[heap] = false;
+                continue;
+            }
+
+            if (usage > budget && !over_budget_reported_[heap])
+            {
+                // 超出预算会导致驱动换页, 这里让它可见
+                fmt::print("memory heap {} over budget: {} MB used, {} MB budget\n", heap, usage >> 20, budget >> 20);
+                over_budget_reported_[heap] = true;
+            }
+
+            // 从最久未用的资源开始驱逐, 仍可能被 GPU 使用的资源跳过
+            VkDeviceSize target = static_cast<VkDeviceSize>(budget * kLowWater);
+            auto& lru = lru_[heap];
+            for (auto iter = lru.begin(); iter != lru.end() && usage > target;)
+            {
+                if (iter->last_use > completed_value)
+                {
+                    break;
+                }
+                usage -= std::min(usage, iter->size);
+                victims.push_back(std::move(iter->evict));
+                entries_.erase(iter->id);
+                iter = lru.erase(iter);
+            }
+        }
+    }
+
+    // 回调里会释放内存, 不持有锁, 避免和分配器的锁交叉
+    for (auto& evict : victims)
+    {
+        if (evict)
+        {
+            evict();
+        }
+    }
+}
+
+GpuResidency::ResidencyId GpuResidency::Register(uint32_t heap_index, VkDeviceSize size, EvictCallback evict)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResidencyId id = next_id_++;
+    auto& lru = lru_[heap_index];
+    lru.push_back(Entry{ id, heap_index, size, 0, std::move(evict) });
+    entries_[id] = std::prev(lru.end());
+    return id;
+}
+
+void GpuResidency::Unregister(ResidencyId id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = entries_.find(id);
+    if (iter == entries_.end())
+    {
+        return;
+    }
+    lru_[iter->second->heap_index].erase(iter->second);
+    entries_.erase(iter);
+}
+
+void GpuResidency::Touch(ResidencyId id, uint64_t timeline_value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = entries_.find(id);
+    if (iter == entries_.end())
+    {
+        return;
+    }
+    auto& lru = lru_[iter->second->heap_index];
+    iter->second->last_use = std::max(iter->second->last_use, timeline_value);
+    lru.splice(lru.end(), lru, iter->second);
+}
+
+bool GpuResidency::CanAllocate(uint32_t heap_index, VkDeviceSize size)
+{
+    // 到高水位就拒绝, 新内存直接落到下一个内存类型, 不必等驱逐腾出空间
+    std::lock_guard<std::mutex> lock(mutex_);
+    return _EstimatedUsage(heap_index) + size <= static_cast<VkDeviceSize>(heaps_[heap_index].budget * kHighWater);
+}
+
+GpuHeapBudget GpuResidency::GetHeapBudget(uint32_t heap_index)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    GpuHeapBudget heap = heaps_[heap_index];
+    heap.usage = _EstimatedUsage(heap_index);
+    heap.own_usage = allocator_ ? allocator_->GetHeapUsage(heap_index) : 0;
+    return heap;
+}
+
+void GpuResidency::_QueryBudget()
+{
+    if (allocator_ == nullptr)
+    {
+        return;
+    }
+
+    if (budget_extension_)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budgetProperties;
+        vk_get_memory_properties2_(vk_physicaldevice_, &properties);
+
+        for (uint32_t i = 0; i < heap_count_; i++)
+        {
+            heaps_[i].budget = budgetProperties.heapBudget[i];
+            heaps_[i].usage = budgetProperties.heapUsage[i];
+            own_usage_at_query_[i] = allocator_->GetHeapUsage(i);
+        }
+        return;
+    }
+
+    // 没有扩展时只能看到自己的使用量, 预算按规范建议取堆大小的 80%
+    for (uint32_t i = 0; i < heap_count_; i++)
+    {
+        heaps_[i].budget = heaps_[i].size / 10 * 8;
+        heaps_[i].usage = 0;
+        own_usage_at_query_[i] = 0;
+    }
+}
+
+VkDeviceSize GpuResidency::_EstimatedUsage(uint32_t heap_index) const
+{
+    // 驱动报告的使用量只在查询时刷新, 期间本进程的增减按分配器统计补上
+    VkDeviceSize own_usage = allocator_ ? allocator_->GetHeapUsage(heap_index) : 0;
+    VkDeviceSize usage = heaps_[heap_index].usage + own_usage;
+    return usage > own_usage_at_query_[heap_index] ? usage - own_usage_at_query_[heap_index] : 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vulkan/vulkan.hpp>
+
+class GpuAllocator;
+
+/**
+ * @brief 单个内存堆的预算
+ */
+struct GpuHeapBudget
+{
+    VkDeviceSize size = 0;          ///< 堆大小
+    VkDeviceSize budget = 0;        ///< 驱动给出的预算, 不支持 VK_EXT_memory_budget 时取堆大小的 80%
+    VkDeviceSize usage = 0;         ///< 估算的使用量, 支持扩展时包含其他进程
+    VkDeviceSize own_usage = 0;     ///< 本进程分配器申请的字节数
+};
+
+/**
+ * @brief 显存驻留管理
+ * 通过 VK_EXT_memory_budget 查询每个堆的预算, 跟踪本进程的使用量.
+ * 注册的资源按最近使用排成 LRU, 使用量超过预算的高水位时, 从最久未用且 GPU 已用完的资源开始回调驱逐,
+ * 由资源所有者决定释放还是降级到系统内存. 分配器申请新内存前也会询问预算, 到达高水位时直接退到系统内存
+ */
+class GpuResidency final
+{
+public:
+    using ResidencyId = uint64_t;
+    using EvictCallback = std::function<void()>;
+
+    GpuResidency() = default;
+    ~GpuResidency() = default;
+
+    GpuResidency(const GpuResidency&) = delete;
+    GpuResidency& operator=(const GpuResidency&) = delete;
+
+    /**
+     * @param budget_extension 设备是否开启了 VK_EXT_memory_budget
+     */
+    bool Init(VkInstance instance, VkPhysicalDevice physical_device, GpuAllocator* allocator, bool budget_extension);
+    void UnInit();
+
+    /**
+     * @brief 每帧在渲染线程调用, 刷新预算并驱逐超出的部分
+     * @param completed_value 图形队列已完成的 timeline 值, 只驱逐此前最后使用的资源
+     */
+    void Update(uint64_t completed_value);
+
+    /**
+     * @brief 注册可驱逐的资源, 回调中释放或降级资源. 回调前已自动注销, 降级后如需继续跟踪需重新注册
+     */
+    ResidencyId Register(uint32_t heap_index, VkDeviceSize size, EvictCallback evict);
+    void Unregister(ResidencyId id);
+
+    /**
+     * @brief 资源在 timeline_value 这次提交中被使用, 移到 LRU 尾部
+     */
+    void Touch(ResidencyId id, uint64_t timeline_value);
+
+    /**
+     * @brief 分配器申请新内存前调用, 超出预算的高水位返回 false
+     */
+    bool CanAllocate(uint32_t heap_index, VkDeviceSize size);
+
+    GpuHeapBudget GetHeapBudget(uint32_t heap_index);
+    bool HasBudgetExtension() const { return budget_extension_; }
+
+private:
+    struct Entry
+    {
+        ResidencyId id = 0;
+        uint32_t heap_index = 0;
+        VkDeviceSize size = 0;
+        uint64_t last_use = 0;
+        EvictCallback evict;
+    };
+
+    void _QueryBudget();
+    VkDeviceSize _EstimatedUsage(uint32_t heap_index) const;
+
+private:
+    static constexpr uint32_t kQueryInterval = 16;  ///< 每隔多少帧向驱动查询一次预算
+    static constexpr double kHighWater = 0.9;       ///< 超过预算的该比例开始驱逐
+    static constexpr double kLowWater = 0.8;        ///< 驱逐到预算的该比例为止
+
+    VkPhysicalDevice vk_physicaldevice_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 vk_get_memory_properties2_ = nullptr;
+    bool budget_extension_ = false;
+    uint32_t heap_count_ = 0;
+    uint32_t frame_counter_ = 0;
+
+    std::mutex mutex_;
+    std::array<GpuHeapBudget, VK_MAX_MEMORY_HEAPS> heaps_{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> own_usage_at_query_{};    ///< 查询时本进程的使用量, 用于估算两次查询之间的变化
+    std::array<bool, VK_MAX_MEMORY_HEAPS> over_budget_reported_{};
+
+    ResidencyId next_id_ = 1;
+    std::array<std::list<Entry>, VK_MAX_MEMORY_HEAPS> lru_;     ///< 每个堆一条 LRU, 头部最久未用
+    std::unordered_map<ResidencyId, std::list<Entry>::iterator> entries_;
+};
@@ -1,601 +1,1022 @@
-#include "gpu_resource.h"
-#include <algorithm>
-#include <cassert>
-#include <limits>
-#include <set>
-#include <Windows.h>
-#undef max
-#ifdef _WIN32
-#include <vulkan/vulkan_win32.h>
-#endif
-#include <fmt/format.h>
-#include <SDL2/SDL_syswm.h>
-#include <SDL2/SDL_video.h>
-#include <SDL2/SDL_vulkan.h>
-
-namespace {
-#define CHECK_OR_RETURN_FALSE(ret) \
-if (!ret) \
-{\
-    fmt::print("function {} - line {} : {} call fail", __FUNCTION__, __LINE__, #ret); \
-    return false;\
-}
-
-#define IF_VK_RETURN_FAIL(ret, function, return_value) \
-if (ret != VK_SUCCESS) \
-{\
-    fmt::print("{} call fail, error: {}\n", #function, ret); \
-    return return_value;\
-}
-}
-
-static VKAPI_ATTR VkBool32 VKAPI_CALL 
-DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, 
-            VkDebugUtilsMessageTypeFlagsEXT messageType, 
-            const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, 
-            void* pUserData) 
-{
-    fmt::print("validation layer: {}\n", pCallbackData->pMessage);
-    return VK_FALSE;
-}
-
-VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, 
-                                    const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, 
-                                    const VkAllocationCallbacks* pAllocator, 
-                                    VkDebugUtilsMessengerEXT* pDebugMessenger) 
-{
-    auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-    if (func != nullptr) {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
-    }
-    else {
-        return VK_ERROR_EXTENSION_NOT_PRESENT;
-    }
-}
-
-void DestroyDebugUtilsMessengerEXT(VkInstance instance, 
-                                VkDebugUtilsMessengerEXT debugMessenger, 
-                                const VkAllocationCallbacks* pAllocator) 
-{
-    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func != nullptr) 
-    {
-        func(instance, debugMessenger, pAllocator);
-    }
-}
-
-GpuResource::~GpuResource()
-{
-	UnInit();
-}
-
-bool GpuResource::Init(SDL_Window* parent_window)
-{
-	parent_window_ = parent_window;
-    CHECK_OR_RETURN_FALSE(_CreateInstatce());
-    //CHECK_OR_RETURN_FALSE(_SetupDebugMessenger());
-    CHECK_OR_RETURN_FALSE(_CreateSurface());
-	CHECK_OR_RETURN_FALSE(_PickPhysicalDevice());
-    // 检测设备是否支持交换链
-    CHECK_OR_RETURN_FALSE(_CheckDeviceExtensionSupport(vk_physicaldevice_, VK_KHR_SWAPCHAIN_EXTENSION_NAME));
-    CHECK_OR_RETURN_FALSE(_CreateLogicDevice());
-    CHECK_OR_RETURN_FALSE(_CreateSwapChain());
-    CHECK_OR_RETURN_FALSE(_CreateImageViews());
-
-	return true;
-}
-
-void GpuResource::UnInit()
-{
-    for (auto& index : vk_swapchain_image_views)
-    {
-        vkDestroyImageView(vk_device_, index, nullptr);
-    }
-    vk_swapchain_image_views.clear();
-
-    if (vk_swap_chain_ != VK_NULL_HANDLE)
-    {
-        vkDestroySwapchainKHR(vk_device_, vk_swap_chain_, nullptr);
-        vk_swap_chain_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_device_ != VK_NULL_HANDLE)
-    {
-        vkDestroyDevice(vk_device_, nullptr);
-        vk_device_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_physicaldevice_ != VK_NULL_HANDLE)
-    {
-        vk_physicaldevice_ = VK_NULL_HANDLE;
-    }
-
-    if (vk_debug_messenger_ != VK_NULL_HANDLE)
-    {
-        DestroyDebugUtilsMessengerEXT(vk_instance_, vk_debug_messenger_, nullptr);
-    }
-
-    if (vk_surface_ != VK_NULL_HANDLE)
-    {
-        vkDestroySurfaceKHR(vk_instance_, vk_surface_, nullptr);
-        vk_surface_ = VK_NULL_HANDLE;
-    }
-
-	if (vk_instance_ != VK_NULL_HANDLE)
-	{
-		vkDestroyInstance(vk_instance_, nullptr);
-        vk_instance_ = VK_NULL_HANDLE;
-	}
-}
-
-bool GpuResource::_CreateInstatce()
-{
-    if (is_debug_)
-    {
-        if (!_CheckValidationLayerSupport()) {
-            return false;
-        }
-    }
-
-    VkApplicationInfo appInfo{};
-    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-    appInfo.pApplicationName = "Vulkan Toturial";
-    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.pEngineName = "No Engine";
-    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
-
-    VkInstanceCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    createInfo.pApplicationInfo = &appInfo;
-
-    uint32_t extension_count = 0;
-    bool ret = SDL_Vulkan_GetInstanceExtensions(parent_window_, &extension_count, nullptr);
-    if (!ret)
-    {
-        return false;
-    }
-    std::vector<const char*> extension_names(extension_count);
-    ret = SDL_Vulkan_GetInstanceExtensions(parent_window_, &extension_count, extension_names.data());
-    if (!ret)
-    {
-        return false;
-    }
-    
-    if (is_debug_)
-    {
-        extension_names.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-    }
-    createInfo.enabledExtensionCount = extension_count;
-    createInfo.ppEnabledExtensionNames = extension_names.data();
-
-    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-    if (is_debug_) 
-    {
-        createInfo.enabledLayerCount = static_cast<uint32_t>(validation_layers_.size());
-        createInfo.ppEnabledLayerNames = validation_layers_.data();
-        _PopulateDebugMessengerCreateInfo(debugCreateInfo);
-        createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
-    }
-    else {
-        createInfo.enabledLayerCount = 0;
-        createInfo.pNext = nullptr;
-    }
-    createInfo.enabledLayerCount = 0;
-
-    VkResult result = vkCreateInstance(&createInfo, nullptr, &vk_instance_);
-    IF_VK_RETURN_FAIL(result, vkCreateInstance, false);
-
-    fmt::print("vkCreateInstance call success\n");
-    return true;
-}
-
-bool GpuResource::_SetupDebugMessenger()
-{
-    if (!is_debug_) 
-    {
-        return true;
-    }
-
-    VkDebugUtilsMessengerCreateInfoEXT createInfo;
-    _PopulateDebugMessengerCreateInfo(createInfo);
-
-    VkResult ret = CreateDebugUtilsMessengerEXT(vk_instance_, &createInfo, nullptr, &vk_debug_messenger_);
-    IF_VK_RETURN_FAIL(ret, CreateDebugUtilsMessengerEXT, false)
-    return true;
-}
-
-bool GpuResource::_CheckValidationLayerSupport()
-{
-    uint32_t layerCount;
-    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-
-    std::vector<VkLayerProperties> availableLayers(layerCount);
-    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-
-    for (const char* layerName : validation_layers_) {
-        bool layerFound = false;
-
-        for (const auto& layerProperties : availableLayers) {
-            if (strcmp(layerName, layerProperties.layerName) == 0) {
-                layerFound = true;
-                break;
-            }
-        }
-
-        if (!layerFound) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-void GpuResource::_PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
-{
-    createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-    createInfo.pfnUserCallback = DebugCallback;
-}
-
-bool GpuResource::_IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface)
-{
-    VkPhysicalDeviceProperties deviceProperties;
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
-    if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU 
-        || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-    {   // 集成显卡
-        QueueFamilyIndices families =  _FindQueueFamilies(device, surface);
-        return families.isComplete();
-    }
-    else {
-        return false;
-    }
-}
-
-bool GpuResource::_PickPhysicalDevice()
-{
-    uint32_t device_count = 0;
-    vkEnumeratePhysicalDevices(vk_instance_, &device_count, nullptr);
-    if (device_count == 0)
-    {
-        return false;
-    }
-    std::vector<VkPhysicalDevice> devices(device_count);
-    vkEnumeratePhysicalDevices(vk_instance_, &device_count, devices.data());
-
-    for (auto index : devices)
-    {
-        if (_IsDeviceSuitable(index, vk_surface_))
-        {
-            vk_physicaldevice_ = index;
-            break;
-        }
-    }
-
-    if (vk_physicaldevice_ == VK_NULL_HANDLE)
-    {
-        return false;
-    }
-
-    return true;
-}
-
-QueueFamilyIndices GpuResource::_FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
-{
-    assert((device != VK_NULL_HANDLE) && "VkPhysicalDevice param cant be empty!");
-    assert((surface != VK_NULL_HANDLE) && "VkSurfaceKHR param cant be empty!");
-
-    QueueFamilyIndices indices;
-
-    // 获取显卡协议
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-    uint32_t i = 0;
-
-    for (const auto& index : queueFamilies)
-    {
-        if (index.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-        {
-            indices.graphicsFamily = i;
-        }
-
-        VkBool32 persentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &persentSupport);
-
-        if (persentSupport)
-        {
-            indices.presentFamily = i;
-        }
-
-        if (indices.isComplete()) {
-            break;
-        }
-        
-        i++;
-    }
-
-    return indices;
-}
-
-bool GpuResource::_CreateLogicDevice()
-{
-    QueueFamilyIndices indices = _FindQueueFamilies(vk_physicaldevice_, vk_surface_);
-    if (!indices.isComplete())
-    {
-        return false;
-    }
-    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
-
-    float queuePriprity = 1.0f;
-    for (uint32_t queueFamily : uniqueQueueFamilies)
-    {
-        VkDeviceQueueCreateInfo queueCreateInfo{};
-        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriprity;
-        queueCreateInfos.push_back(queueCreateInfo);
-    }
-
-    const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-    VkPhysicalDeviceFeatures deviceFeature{};
-    VkDeviceCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-    createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    // 开启设备扩展
-    createInfo.pEnabledFeatures = &deviceFeature;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-
-    // 验证层
-    if (is_debug_)
-    {
-        createInfo.enabledLayerCount = static_cast<uint32_t>(validation_layers_.size());
-        createInfo.ppEnabledLayerNames = validation_layers_.data();
-    }
-    else {
-        createInfo.enabledLayerCount = 0;
-    }
-
-    VkResult ret = vkCreateDevice(vk_physicaldevice_, &createInfo, nullptr, &vk_device_);
-    IF_VK_RETURN_FAIL(ret, vkCreateDevice, false)
-
-    vkGetDeviceQueue(vk_device_, indices.graphicsFamily.value(), 0, &vk_graphics_queue_);
-    vkGetDeviceQueue(vk_device_, indices.presentFamily.value(), 0, &vk_present_queue_);
-    
-    vk_graphics_family_ = indices.graphicsFamily.value();
-    vk_present_family_ = indices.presentFamily.value();
-    
-    return true;
-}
-
-bool GpuResource::_CreateSurface()
-{
-    if (SDL_TRUE != SDL_Vulkan_CreateSurface(parent_window_, vk_instance_, &vk_surface_))
-    {
-        fmt::print("SDL_Vulkan_CreateSurface generate VkSurfaceKHR fail!\n");
-        return false;
-    }
-    return true;
-}
-
-bool GpuResource::_CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::string& extension_name)
-{
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
-    for (const auto& index : availableExtensions)
-    {
-        if (index.extensionName == extension_name)
-        {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-bool GpuResource::_CreateSwapChain()
-{
-    SwapChainSupportDetails swap_chain_support = _QuerySwapChainSupport(vk_physicaldevice_, vk_surface_);
-    if (swap_chain_support.formats.empty() || swap_chain_support.presentModes.empty())
-    {
-        return false;
-    }
-
-    // 选择可支持的交换链
-    std::optional<VkSurfaceFormatKHR> surfaceFormat =  _ChooseSwapSurfaceFormat(swap_chain_support.formats);
-
-    // 选择呈现模式
-    std::optional<VkPresentModeKHR> presentMode = _ChooseSwapPresentMode(swap_chain_support.presentModes);
-
-    // 获取视口输出大小
-    VkExtent2D extent = _ChooseSwapExtent(swap_chain_support.capabilities);
-
-    if (!surfaceFormat.has_value() || !presentMode.has_value())
-    {
-        return false;
-    }
-    
-    // 多申请一张图片
-    uint32_t imageCount = swap_chain_support.capabilities.minImageCount + 1;
-    if (swap_chain_support.capabilities.maxImageCount > 0 && imageCount > swap_chain_support.capabilities.maxImageCount)
-    {
-        imageCount = swap_chain_support.capabilities.maxImageCount;
-    }
-
-    VkSwapchainCreateInfoKHR createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createInfo.surface = vk_surface_;
-    createInfo.minImageCount = imageCount;
-    createInfo.imageFormat = surfaceFormat.value().format;
-    createInfo.imageColorSpace = surfaceFormat.value().colorSpace;
-    createInfo.imageExtent = extent;
-    createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    QueueFamilyIndices indices = _FindQueueFamilies(vk_physicaldevice_, vk_surface_);
-    CHECK_OR_RETURN_FALSE(indices.isComplete())
-    uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value()};
-
-    if (indices.graphicsFamily != indices.presentFamily)
-    {
-        createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-        createInfo.queueFamilyIndexCount = 2;
-        createInfo.pQueueFamilyIndices = queueFamilyIndices;
-    }
-    else {
-        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    }
-    createInfo.preTransform = swap_chain_support.capabilities.currentTransform; // 画面翻转
-    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = presentMode.value();
-    createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE; // 记录旧的交换链
-
-    VkResult ret = vkCreateSwapchainKHR(vk_device_, &createInfo, nullptr, &vk_swap_chain_);
-    IF_VK_RETURN_FAIL(ret, vkCreateSwapchainKHR, false)
-
-    uint32_t swapchainImageCount = 0;
-    vkGetSwapchainImagesKHR(vk_device_, vk_swap_chain_, &swapchainImageCount, nullptr);
-    vk_swapchain_images_.resize(swapchainImageCount);
-    vkGetSwapchainImagesKHR(vk_device_, vk_swap_chain_, &swapchainImageCount, vk_swapchain_images_.data());
-
-    vk_swapchain_image_format = surfaceFormat.value().format;
-    vk_swapchain_image_extent = extent;
-
-    return true;
-}
-
-SwapChainSupportDetails GpuResource::_QuerySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface)
-{
-    SwapChainSupportDetails details;
-    // 获取 Surface 参数
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, vk_surface_, &details.capabilities);
-
-    // 查询支持的格式
-    uint32_t formatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, vk_surface_, &formatCount, nullptr);
-    if (formatCount > 0)
-    {
-        details.formats.resize(formatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, vk_surface_, &formatCount, details.formats.data());
-    }
-
-    // 查询支持的呈现模式
-    uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, vk_surface_, &presentModeCount, nullptr);
-    if (presentModeCount > 0)
-    {
-        details.presentModes.resize(presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, vk_surface_, &presentModeCount, details.presentModes.data());
-    }
-
-    return details;
-}
-
-std::optional<VkSurfaceFormatKHR> GpuResource::_ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
-{
-    std::optional<VkSurfaceFormatKHR> result;
-    for (const auto& availableFormat : availableFormats)
-    {
-        if (availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB)
-        {
-            result = availableFormat;
-            break;
-        }
-    }
-
-    return result;
-}
-
-std::optional<VkPresentModeKHR> GpuResource::_ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
-{
-    std::optional<VkPresentModeKHR> result;
-    std::set<VkPresentModeKHR> present_mode(availablePresentModes.begin(), availablePresentModes.end());
-
-    // 呈现策略
-    if (present_mode.contains(VK_PRESENT_MODE_MAILBOX_KHR))
-    {
-        // 开垂直同步 但新帧会替代等待队列里帧 减少了等待事件
-        result = VK_PRESENT_MODE_MAILBOX_KHR;
-    }
-    else if (present_mode.contains(VK_PRESENT_MODE_FIFO_KHR))
-    {
-        // 开垂直同步 并显示按序列显示
-        result = VK_PRESENT_MODE_FIFO_KHR;
-    }
-    else if (present_mode.contains(VK_PRESENT_MODE_IMMEDIATE_KHR))
-    {
-        // 立即模式 不开垂直同步
-        result = VK_PRESENT_MODE_IMMEDIATE_KHR;
-    }
-
-    return result;
-}
-
-VkExtent2D GpuResource::_ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
-{
-    VkExtent2D result;
-
-    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
-    {
-        return capabilities.currentExtent;
-    }
-    else {
-        int32_t width = 0;
-        int32_t height = 0;
-        SDL_Vulkan_GetDrawableSize(parent_window_,
-                                reinterpret_cast<int32_t*>(&result.width), 
-                                reinterpret_cast<int32_t*>(&result.height));
-
-        result.width = std::clamp(result.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
-        result.height = std::clamp(result.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
-    }
-
-    return result;
-}
-
-bool GpuResource::_CreateImageViews()
-{
-    vk_swapchain_image_views.resize(vk_swapchain_images_.size());
-    for (size_t i = 0; i < vk_swapchain_images_.size(); i++)
-    {
-        VkImageViewCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        createInfo.image = vk_swapchain_images_[i];
-        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        createInfo.format = vk_swapchain_image_format;
-        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        createInfo.subresourceRange.baseMipLevel = 0;
-        createInfo.subresourceRange.levelCount = 1;
-        createInfo.subresourceRange.baseArrayLayer = 0;
-        createInfo.subresourceRange.layerCount = 1;
-
-        VkResult result = vkCreateImageView(vk_device_, &createInfo, nullptr, &vk_swapchain_image_views[i]);
-        if (result != VK_SUCCESS)
-        {
-            fmt::print("create image view fail!\n");
-        }
-    }
-
-    return true;
-}
\ No newline at end of file
+#include "gpu_resource.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <set>
+#ifdef _WIN32
+#include <Windows.h>
+#undef max
+#include <vulkan/vulkan_win32.h>
+#endif
+#include <fmt/format.h>
+#include <SDL2/SDL_syswm.h>
+#include "gpu_host_allocator.h"
+#include <SDL2/SDL_video.h>
+#include <SDL2/SDL_vulkan.h>
+
+namespace {
+#define CHECK_OR_RETURN_FALSE(ret) \
+if (!ret) \
+{\
+    fmt::print("function {} - line {} : {} call fail", __FUNCTION__, __LINE__, #ret); \
+    return false;\
+}
+
+#define IF_VK_RETURN_FAIL(ret, function, return_value) \
+if (ret != VK_SUCCESS) \
+{\
+    fmt::print("{} call fail, error: {}\n", #function, ret); \
+    return return_value;\
+}
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL 
+DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, 
+            VkDebugUtilsMessageTypeFlagsEXT messageType, 
+            const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, 
+            void* pUserData) 
+{
+    fmt::print("validation layer: {}\n", pCallbackData->pMessage);
+    return VK_FALSE;
+}
+
+VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, 
+                                    const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, 
+                                    const VkAllocationCallbacks* pAllocator, 
+                                    VkDebugUtilsMessengerEXT* pDebugMessenger) 
+{
+    auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+    if (func != nullptr) {
+        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    }
+    else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance, 
+                                VkDebugUtilsMessengerEXT debugMessenger, 
+                                const VkAllocationCallbacks* pAllocator) 
+{
+    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (func != nullptr) 
+    {
+        func(instance, debugMessenger, pAllocator);
+    }
+}
+
+GpuResource::~GpuResource()
+{
+	UnInit();
+}
+
+bool GpuResource::Init(SDL_Window* parent_window, const GpuConfig& config)
+{
+	parent_window_ = parent_window;
+    headless_ = config.headless || parent_window == nullptr;
+    present_profile_ = config.present_profile;
+    dynamic_rendering_ = config.dynamic_rendering;
+    is_debug_ = config.validation;
+    // 实例创建之后不能再切换, 否则创建和销毁使用的回调不一致
+    if (vk_instance_ == VK_NULL_HANDLE)
+    {
+        GpuHostAllocator::GetInstance()->SetEnabled(config.host_allocator);
+    }
+    CHECK_OR_RETURN_FALSE(_CreateInstatce());
+    //CHECK_OR_RETURN_FALSE(_SetupDebugMessenger());
+    if (!headless_)
+    {
+        CHECK_OR_RETURN_FALSE(_CreateSurface());
+    }
+	CHECK_OR_RETURN_FALSE(_PickPhysicalDevice());
+    CHECK_OR_RETURN_FALSE(_CreateLogicDevice());
+    CHECK_OR_RETURN_FALSE(graphics_timeline_.Init(vk_device_));
+    CHECK_OR_RETURN_FALSE(allocator_.Init(vk_device_, vk_physicaldevice_properties_, vk_memory_properties_));
+    CHECK_OR_RETURN_FALSE(residency_.Init(vk_instance_, vk_physicaldevice_, &allocator_, memory_budget_supported_));
+    allocator_.SetBudgetCallback([this](uint32_t heap_index, VkDeviceSize size) {
+        return residency_.CanAllocate(heap_index, size);
+    });
+    allocator_.SetSpareBlockCallbacks(
+        [this](uint32_t heap_index, VkDeviceSize size, std::function<void()> evict) {
+            return residency_.Register(heap_index, size, std::move(evict));
+        },
+        [this](uint64_t id) { residency_.Unregister(id); });
+    CHECK_OR_RETURN_FALSE(staging_ring_.Init(vk_device_, &allocator_, config.staging_size, GetLimits().nonCoherentAtomSize));
+    CHECK_OR_RETURN_FALSE(upload_engine_.Init(this, config.upload_staging_size));
+    CHECK_OR_RETURN_FALSE(shader_cache_.Init(vk_device_));
+    CHECK_OR_RETURN_FALSE(pipeline_cache_.Init(vk_device_, vk_physicaldevice_properties_, config.pipeline_cache_path));
+    CHECK_OR_RETURN_FALSE(pipeline_compiler_.Init(vk_device_, &pipeline_cache_, config.pipeline_compile_threads));
+    CHECK_OR_RETURN_FALSE(pipeline_library_.Init(vk_device_, &pipeline_compiler_));
+    if (headless_)
+    {
+        CHECK_OR_RETURN_FALSE(_CreateOffscreenTargets(config.headless_extent, config.headless_image_count));
+    }
+    else {
+        CHECK_OR_RETURN_FALSE(_CreateSwapChain());
+    }
+    CHECK_OR_RETURN_FALSE(_CreateImageViews());
+    for (uint32_t i = 0; i < offscreen_images_.size(); i++)
+    {
+        _RegisterOffscreenTarget(i);
+    }
+
+	return true;
+}
+
+void GpuResource::UnInit()
+{
+    // 调用方已等待设备空闲
+    deletion_queue_.Flush();
+
+    for (auto& index : vk_swapchain_image_views)
+    {
+        vkDestroyImageView(vk_device_, index, GpuHostCallbacks());
+    }
+    vk_swapchain_image_views.clear();
+
+    if (vk_swap_chain_ != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(vk_device_, vk_swap_chain_, GpuHostCallbacks());
+        vk_swap_chain_ = VK_NULL_HANDLE;
+    }
+    vk_swapchain_images_.clear();
+
+    // 离屏图片由自己创建, 需要自己释放
+    for (auto& index : offscreen_images_)
+    {
+        allocator_.DestroyImage(index);
+    }
+    offscreen_images_.clear();
+    offscreen_residency_.clear();
+    render_targets_changed_ = false;
+
+    pipeline_library_.UnInit();
+    // 编译线程先交回工作缓存, 再合并写回
+    pipeline_compiler_.UnInit();
+    shader_cache_.UnInit();
+    pipeline_cache_.UnInit();
+    upload_engine_.UnInit();
+    staging_ring_.UnInit();
+    allocator_.SetBudgetCallback(nullptr);
+    allocator_.SetSpareBlockCallbacks(nullptr, nullptr);
+    residency_.UnInit();
+    allocator_.UnInit();
+    graphics_timeline_.UnInit();
+
+    if (vk_device_ != VK_NULL_HANDLE)
+    {
+        vkDestroyDevice(vk_device_, GpuHostCallbacks());
+        vk_device_ = VK_NULL_HANDLE;
+    }
+
+    if (vk_physicaldevice_ != VK_NULL_HANDLE)
+    {
+        vk_physicaldevice_ = VK_NULL_HANDLE;
+    }
+
+    if (vk_debug_messenger_ != VK_NULL_HANDLE)
+    {
+        DestroyDebugUtilsMessengerEXT(vk_instance_, vk_debug_messenger_, GpuHostCallbacks());
+    }
+
+    // SDL 创建 surface 时没有传分配回调, 销毁时也不能传
+    if (vk_surface_ != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(vk_instance_, vk_surface_, nullptr);
+        vk_surface_ = VK_NULL_HANDLE;
+    }
+
+	if (vk_instance_ != VK_NULL_HANDLE)
+	{
+		vkDestroyInstance(vk_instance_, GpuHostCallbacks());
+        vk_instance_ = VK_NULL_HANDLE;
+        GpuHostAllocator::GetInstance()->PrintStats();
+	}
+}
+
+bool GpuResource::_CreateInstatce()
+{
+    // 按需开启校验层, 没有安装 (如只有 lavapipe 的 CI 机器) 时不开启, 继续运行
+    if (is_debug_ && !_CheckValidationLayerSupport())
+    {
+        fmt::print("validation layer not available, continue without it\n");
+        is_debug_ = false;
+    }
+
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Vulkan Toturial";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_3;    // timeline semaphore 需要 1.2, 动态渲染需要 1.3, 低版本设备走对应扩展
+
+    VkInstanceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    // 无窗口模式不需要 surface 相关扩展
+    uint32_t extension_count = 0;
+    std::vector<const char*> extension_names;
+    if (!headless_)
+    {
+        bool ret = SDL_Vulkan_GetInstanceExtensions(parent_window_, &extension_count, nullptr);
+        if (!ret)
+        {
+            return false;
+        }
+        extension_names.resize(extension_count);
+        ret = SDL_Vulkan_GetInstanceExtensions(parent_window_, &extension_count, extension_names.data());
+        if (!ret)
+        {
+            return false;
+        }
+    }
+    
+    if (is_debug_)
+    {
+        extension_names.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extension_names.size());
+    createInfo.ppEnabledExtensionNames = extension_names.data();
+
+    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+    if (is_debug_) 
+    {
+        createInfo.enabledLayerCount = static_cast<uint32_t>(validation_layers_.size());
+        createInfo.ppEnabledLayerNames = validation_layers_.data();
+        _PopulateDebugMessengerCreateInfo(debugCreateInfo);
+        createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+    }
+    else {
+        createInfo.enabledLayerCount = 0;
+        createInfo.pNext = nullptr;
+    }
+
+    VkResult result = vkCreateInstance(&createInfo, GpuHostCallbacks(), &vk_instance_);
+    IF_VK_RETURN_FAIL(result, vkCreateInstance, false);
+
+    fmt::print("vkCreateInstance call success\n");
+    return true;
+}
+
+bool GpuResource::_SetupDebugMessenger()
+{
+    if (!is_debug_) 
+    {
+        return true;
+    }
+
+    VkDebugUtilsMessengerCreateInfoEXT createInfo;
+    _PopulateDebugMessengerCreateInfo(createInfo);
+
+    VkResult ret = CreateDebugUtilsMessengerEXT(vk_instance_, &createInfo, GpuHostCallbacks(), &vk_debug_messenger_);
+    IF_VK_RETURN_FAIL(ret, CreateDebugUtilsMessengerEXT, false)
+    return true;
+}
+
+bool GpuResource::_CheckValidationLayerSupport()
+{
+    uint32_t layerCount;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+
+    std::vector<VkLayerProperties> availableLayers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+
+    for (const char* layerName : validation_layers_) {
+        bool layerFound = false;
+
+        for (const auto& layerProperties : availableLayers) {
+            if (strcmp(layerName, layerProperties.layerName) == 0) {
+                layerFound = true;
+                break;
+            }
+        }
+
+        if (!layerFound) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GpuResource::_PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
+{
+    createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo.pfnUserCallback = DebugCallback;
+}
+
+bool GpuResource::_IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface)
+{
+    QueueFamilyIndices families =  _FindQueueFamilies(device, surface);
+    if (!families.isComplete() || !_CheckTimelineSemaphoreSupport(device))
+    {
+        return false;
+    }
+
+    // 检测设备是否支持交换链
+    if (!headless_ && !_CheckDeviceExtensionSupport(device, VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+    {
+        return false;
+    }
+    return true;
+}
+
+bool GpuResource::_PickPhysicalDevice()
+{
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(vk_instance_, &device_count, nullptr);
+    if (device_count == 0)
+    {
+        return false;
+    }
+    std::vector<VkPhysicalDevice> devices(device_count);
+    vkEnumeratePhysicalDevices(vk_instance_, &device_count, devices.data());
+
+    // 优先选择集成显卡和独立显卡, 没有时退回到软件实现 (例如 lavapipe)
+    VkPhysicalDevice fallback = VK_NULL_HANDLE;
+    for (auto index : devices)
+    {
+        if (!_IsDeviceSuitable(index, vk_surface_))
+        {
+            continue;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(index, &properties);
+        if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU 
+            || properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+        {
+            vk_physicaldevice_ = index;
+            break;
+        }
+        else if (fallback == VK_NULL_HANDLE) {
+            fallback = index;
+        }
+    }
+
+    if (vk_physicaldevice_ == VK_NULL_HANDLE)
+    {
+        vk_physicaldevice_ = fallback;
+    }
+
+    if (vk_physicaldevice_ == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+
+    // 属性, 限制和内存类型只查询一次, 之后的分配路径直接使用缓存
+    vkGetPhysicalDeviceProperties(vk_physicaldevice_, &vk_physicaldevice_properties_);
+    vkGetPhysicalDeviceMemoryProperties(vk_physicaldevice_, &vk_memory_properties_);
+    vk_device_api_version_ = vk_physicaldevice_properties_.apiVersion;
+    fmt::print("pick physical device: {}\n", vk_physicaldevice_properties_.deviceName);
+    return true;
+}
+
+QueueFamilyIndices GpuResource::_FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
+{
+    assert((device != VK_NULL_HANDLE) && "VkPhysicalDevice param cant be empty!");
+
+    QueueFamilyIndices indices;
+
+    // 获取显卡协议
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t i = 0;
+
+    for (const auto& index : queueFamilies)
+    {
+        if ((index.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value())
+        {
+            indices.graphicsFamily = i;
+        }
+
+        // 无窗口模式没有 surface, 不需要呈现队列, 直接复用图形队列
+        VkBool32 persentSupport = false;
+        if (surface != VK_NULL_HANDLE)
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &persentSupport);
+        }
+        else {
+            persentSupport = (index.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        }
+
+        if (persentSupport && !indices.presentFamily.has_value())
+        {
+            indices.presentFamily = i;
+        }
+
+        // 只带传输能力的队列族一般对应独立 DMA 引擎, 和图形队列并行执行拷贝
+        if ((index.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(index.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+            && !indices.transferFamily.has_value())
+        {
+            indices.transferFamily = i;
+        }
+
+        i++;
+    }
+
+    return indices;
+}
+
+bool GpuResource::_CreateLogicDevice()
+{
+    QueueFamilyIndices indices = _FindQueueFamilies(vk_physicaldevice_, vk_surface_);
+    if (!indices.isComplete())
+    {
+        return false;
+    }
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.transferFamily.has_value())
+    {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
+
+    float queuePriprity = 1.0f;
+    for (uint32_t queueFamily : uniqueQueueFamilies)
+    {
+        VkDeviceQueueCreateInfo queueCreateInfo{};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = queueFamily;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriprity;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    std::vector<const char*> deviceExtensions;
+    if (!headless_)
+    {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+    if (vk_device_api_version_ < VK_API_VERSION_1_2)
+    {
+        deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+    // 可选: 查询各个堆的预算, 用于驻留管理
+    memory_budget_supported_ = _CheckDeviceExtensionSupport(vk_physicaldevice_, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memory_budget_supported_)
+    {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // 可选: 动态渲染, 不支持时退回渲染通道
+    dynamic_rendering_ = dynamic_rendering_ && _CheckDynamicRenderingSupport(vk_physicaldevice_);
+    if (dynamic_rendering_ && vk_device_api_version_ < VK_API_VERSION_1_3)
+    {
+        deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeature{};
+    timelineFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeature.timelineSemaphore = VK_TRUE;
+
+    // 可选: 渲染通道路径下的无图片帧缓冲, 动态渲染时用不到
+    imageless_framebuffer_ = !dynamic_rendering_ && _CheckImagelessFramebufferSupport(vk_physicaldevice_);
+
+    // 可选特性依次挂在 timeline 特性之后
+    void** featureNext = &timelineFeature.pNext;
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{};
+    dynamicRenderingFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    dynamicRenderingFeature.dynamicRendering = VK_TRUE;
+    if (dynamic_rendering_)
+    {
+        *featureNext = &dynamicRenderingFeature;
+        featureNext = &dynamicRenderingFeature.pNext;
+    }
+    VkPhysicalDeviceImagelessFramebufferFeatures imagelessFeature{};
+    imagelessFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES;
+    imagelessFeature.imagelessFramebuffer = VK_TRUE;
+    if (imageless_framebuffer_)
+    {
+        *featureNext = &imagelessFeature;
+        featureNext = &imagelessFeature.pNext;
+    }
+
+    VkPhysicalDeviceFeatures deviceFeature{};
+    VkDeviceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &timelineFeature;
+    createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+    // 开启设备扩展
+    createInfo.pEnabledFeatures = &deviceFeature;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+    // 验证层
+    if (is_debug_)
+    {
+        createInfo.enabledLayerCount = static_cast<uint32_t>(validation_layers_.size());
+        createInfo.ppEnabledLayerNames = validation_layers_.data();
+    }
+    else {
+        createInfo.enabledLayerCount = 0;
+    }
+
+    VkResult ret = vkCreateDevice(vk_physicaldevice_, &createInfo, GpuHostCallbacks(), &vk_device_);
+    IF_VK_RETURN_FAIL(ret, vkCreateDevice, false)
+
+    vkGetDeviceQueue(vk_device_, indices.graphicsFamily.value(), 0, &vk_graphics_queue_);
+    vkGetDeviceQueue(vk_device_, indices.presentFamily.value(), 0, &vk_present_queue_);
+    
+    vk_graphics_family_ = indices.graphicsFamily.value();
+    vk_present_family_ = indices.presentFamily.value();
+
+    vk_transfer_family_ = indices.transferFamily.value_or(indices.graphicsFamily.value());
+    vkGetDeviceQueue(vk_device_, vk_transfer_family_, 0, &vk_transfer_queue_);
+
+    if (dynamic_rendering_)
+    {
+        // 扩展版本的函数只能按 KHR 名字取到
+        bool core = vk_device_api_version_ >= VK_API_VERSION_1_3;
+        vk_cmd_begin_rendering_ = reinterpret_cast<PFN_vkCmdBeginRendering>(
+            vkGetDeviceProcAddr(vk_device_, core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"));
+        vk_cmd_end_rendering_ = reinterpret_cast<PFN_vkCmdEndRendering>(
+            vkGetDeviceProcAddr(vk_device_, core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"));
+        dynamic_rendering_ = vk_cmd_begin_rendering_ != nullptr && vk_cmd_end_rendering_ != nullptr;
+    }
+    fmt::print("render path: {}\n", dynamic_rendering_ ? "dynamic rendering"
+        : imageless_framebuffer_ ? "render pass (imageless framebuffer)" : "render pass");
+    
+    return true;
+}
+
+bool GpuResource::_CreateSurface()
+{
+    if (SDL_TRUE != SDL_Vulkan_CreateSurface(parent_window_, vk_instance_, &vk_surface_))
+    {
+        fmt::print("SDL_Vulkan_CreateSurface generate VkSurfaceKHR fail!\n");
+        return false;
+    }
+    return true;
+}
+
+bool GpuResource::_CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::string& extension_name)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& index : availableExtensions)
+    {
+        if (index.extensionName == extension_name)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool GpuResource::_CheckTimelineSemaphoreSupport(VkPhysicalDevice device)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2 
+        && !_CheckDeviceExtensionSupport(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeature{};
+    timelineFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeature;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return timelineFeature.timelineSemaphore == VK_TRUE;
+}
+
+bool GpuResource::_CheckDynamicRenderingSupport(VkPhysicalDevice device)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    // 扩展依赖 1.2 核心的 depth_stencil_resolve, 更低的版本直接退回渲染通道
+    if (properties.apiVersion < VK_API_VERSION_1_2)
+    {
+        return false;
+    }
+    if (properties.apiVersion < VK_API_VERSION_1_3
+        && !_CheckDeviceExtensionSupport(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{};
+    dynamicRenderingFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &dynamicRenderingFeature;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return dynamicRenderingFeature.dynamicRendering == VK_TRUE;
+}
+
+bool GpuResource::_CheckImagelessFramebufferSupport(VkPhysicalDevice device)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    // 1.1 上的扩展还依赖 VK_KHR_image_format_list, 只使用 1.2 核心版本
+    if (properties.apiVersion < VK_API_VERSION_1_2)
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceImagelessFramebufferFeatures imagelessFeature{};
+    imagelessFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &imagelessFeature;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return imagelessFeature.imagelessFramebuffer == VK_TRUE;
+}
+
+bool GpuResource::RecreateSwapChain()
+{
+    if (headless_)
+    {
+        return true;
+    }
+
+    // 最小化时 surface 大小为 0, 无法创建交换链, 保留旧交换链
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk_physicaldevice_, vk_surface_, &capabilities);
+    VkExtent2D extent = _ChooseSwapExtent(capabilities);
+    if (extent.width == 0 || extent.height == 0)
+    {
+        return false;
+    }
+
+    VkSwapchainKHR old_swapchain = vk_swap_chain_;
+    std::vector<VkImageView> old_views = std::move(vk_swapchain_image_views);
+    vk_swapchain_image_views.clear();
+    vk_swap_chain_ = VK_NULL_HANDLE;
+
+    bool result = _CreateSwapChain(old_swapchain) && _CreateImageViews();
+
+    // 无论新交换链是否创建成功, 旧交换链都已经被废弃.
+    // 旧图片最后一次 present 排在当前已提交的帧之后, 等下一帧完成时 present 队列一定已经处理过它
+    uint64_t retire_value = graphics_timeline_.PendingValue() + 1;
+    VkDevice device = vk_device_;
+    deletion_queue_.Push(retire_value, [device, old_swapchain, old_views]() {
+        for (auto& index : old_views)
+        {
+            vkDestroyImageView(device, index, GpuHostCallbacks());
+        }
+        if (old_swapchain != VK_NULL_HANDLE)
+        {
+            vkDestroySwapchainKHR(device, old_swapchain, GpuHostCallbacks());
+        }
+    });
+
+    return result;
+}
+
+bool GpuResource::_CreateSwapChain(VkSwapchainKHR old_swapchain)
+{
+    SwapChainSupportDetails swap_chain_support = _QuerySwapChainSupport(vk_physicaldevice_, vk_surface_);
+    if (swap_chain_support.formats.empty() || swap_chain_support.presentModes.empty())
+    {
+        return false;
+    }
+
+    // 选择可支持的交换链
+    std::optional<VkSurfaceFormatKHR> surfaceFormat =  _ChooseSwapSurfaceFormat(swap_chain_support.formats);
+
+    // 选择呈现模式
+    std::optional<VkPresentModeKHR> presentMode = _ChooseSwapPresentMode(swap_chain_support.presentModes);
+
+    // 获取视口输出大小
+    VkExtent2D extent = _ChooseSwapExtent(swap_chain_support.capabilities);
+
+    if (!surfaceFormat.has_value() || !presentMode.has_value())
+    {
+        return false;
+    }
+    
+    uint32_t imageCount = _ChooseSwapImageCount(swap_chain_support.capabilities, presentMode.value());
+
+    VkSwapchainCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.surface = vk_surface_;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = surfaceFormat.value().format;
+    createInfo.imageColorSpace = surfaceFormat.value().colorSpace;
+    createInfo.imageExtent = extent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    vk_swapchain_image_usage_ = createInfo.imageUsage;
+    QueueFamilyIndices indices = _FindQueueFamilies(vk_physicaldevice_, vk_surface_);
+    CHECK_OR_RETURN_FALSE(indices.isComplete())
+    uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value()};
+
+    if (indices.graphicsFamily != indices.presentFamily)
+    {
+        createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = 2;
+        createInfo.pQueueFamilyIndices = queueFamilyIndices;
+    }
+    else {
+        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    createInfo.preTransform = swap_chain_support.capabilities.currentTransform; // 画面翻转
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    createInfo.presentMode = presentMode.value();
+    createInfo.clipped = VK_TRUE;
+    createInfo.oldSwapchain = old_swapchain; // 记录旧的交换链, 驱动可复用其资源
+
+    VkResult ret = vkCreateSwapchainKHR(vk_device_, &createInfo, GpuHostCallbacks(), &vk_swap_chain_);
+    IF_VK_RETURN_FAIL(ret, vkCreateSwapchainKHR, false)
+
+    uint32_t swapchainImageCount = 0;
+    vkGetSwapchainImagesKHR(vk_device_, vk_swap_chain_, &swapchainImageCount, nullptr);
+    vk_swapchain_images_.resize(swapchainImageCount);
+    vkGetSwapchainImagesKHR(vk_device_, vk_swap_chain_, &swapchainImageCount, vk_swapchain_images_.data());
+
+    vk_swapchain_image_format = surfaceFormat.value().format;
+    vk_swapchain_image_extent = extent;
+    vk_present_mode_ = presentMode.value();
+
+    fmt::print("swapchain: {}x{}, present mode {}, {} images\n", 
+        extent.width, extent.height, static_cast<int32_t>(vk_present_mode_), vk_swapchain_images_.size());
+    return true;
+}
+
+SwapChainSupportDetails GpuResource::_QuerySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface)
+{
+    SwapChainSupportDetails details;
+    // 获取 Surface 参数
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, vk_surface_, &details.capabilities);
+
+    // 查询支持的格式
+    uint32_t formatCount;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, vk_surface_, &formatCount, nullptr);
+    if (formatCount > 0)
+    {
+        details.formats.resize(formatCount);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, vk_surface_, &formatCount, details.formats.data());
+    }
+
+    // 查询支持的呈现模式
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, vk_surface_, &presentModeCount, nullptr);
+    if (presentModeCount > 0)
+    {
+        details.presentModes.resize(presentModeCount);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, vk_surface_, &presentModeCount, details.presentModes.data());
+    }
+
+    return details;
+}
+
+std::optional<VkSurfaceFormatKHR> GpuResource::_ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+{
+    std::optional<VkSurfaceFormatKHR> result;
+    for (const auto& availableFormat : availableFormats)
+    {
+        if (availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB)
+        {
+            result = availableFormat;
+            break;
+        }
+    }
+
+    return result;
+}
+
+std::optional<VkPresentModeKHR> GpuResource::_ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+{
+    // MAILBOX: 开垂直同步 但新帧会替代等待队列里帧 减少了等待事件
+    // FIFO: 开垂直同步 并显示按序列显示, 所有设备都支持
+    // IMMEDIATE: 立即模式 不开垂直同步
+    static const std::vector<VkPresentModeKHR> kBalanced = 
+        { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+    static const std::vector<VkPresentModeKHR> kLowLatency = 
+        { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const std::vector<VkPresentModeKHR> kPowerSaving = 
+        { VK_PRESENT_MODE_FIFO_KHR };
+    static const std::vector<VkPresentModeKHR> kMaxThroughput = 
+        { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+
+    const std::vector<VkPresentModeKHR>* preference = &kBalanced;
+    switch (present_profile_)
+    {
+    case PresentProfile::kLowLatency:
+        preference = &kLowLatency;
+        break;
+    case PresentProfile::kPowerSaving:
+        preference = &kPowerSaving;
+        break;
+    case PresentProfile::kMaxThroughput:
+        preference = &kMaxThroughput;
+        break;
+    default:
+        break;
+    }
+
+    std::optional<VkPresentModeKHR> result;
+    std::set<VkPresentModeKHR> present_mode(availablePresentModes.begin(), availablePresentModes.end());
+    for (auto index : *preference)
+    {
+        if (present_mode.contains(index))
+        {
+            result = index;
+            break;
+        }
+    }
+
+    return result;
+}
+
+uint32_t GpuResource::_ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR present_mode)
+{
+    uint32_t imageCount = capabilities.minImageCount + 1;
+    switch (present_profile_)
+    {
+    case PresentProfile::kLowLatency:
+        // MAILBOX 需要三张图片才能不阻塞, 其余模式排队的图片越少延迟越低
+        imageCount = present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? std::max(capabilities.minImageCount, 3u) : capabilities.minImageCount;
+        break;
+    case PresentProfile::kPowerSaving:
+        // 双缓冲, GPU 最多领先一帧
+        imageCount = std::max(capabilities.minImageCount, 2u);
+        break;
+    default:
+        // 多申请一张图片
+        break;
+    }
+
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+    {
+        imageCount = capabilities.maxImageCount;
+    }
+    return imageCount;
+}
+
+VkExtent2D GpuResource::_ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
+{
+    VkExtent2D result;
+
+    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+    {
+        return capabilities.currentExtent;
+    }
+    else {
+        int32_t width = 0;
+        int32_t height = 0;
+        SDL_Vulkan_GetDrawableSize(parent_window_,
+                                reinterpret_cast<int32_t*>(&result.width), 
+                                reinterpret_cast<int32_t*>(&result.height));
+
+        result.width = std::clamp(result.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        result.height = std::clamp(result.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+    }
+
+    return result;
+}
+
+bool GpuResource::_CreateImageViews()
+{
+    vk_swapchain_image_views.resize(vk_swapchain_images_.size());
+    for (size_t i = 0; i < vk_swapchain_images_.size(); i++)
+    {
+        if (!_CreateImageView(vk_swapchain_images_[i], vk_swapchain_image_views[i]))
+        {
+            fmt::print("create image view fail!\n");
+        }
+    }
+
+    return true;
+}
+
+bool GpuResource::_CreateImageView(VkImage image, VkImageView& view)
+{
+    VkImageViewCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    createInfo.image = image;
+    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.format = vk_swapchain_image_format;
+    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    createInfo.subresourceRange.baseMipLevel = 0;
+    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.baseArrayLayer = 0;
+    createInfo.subresourceRange.layerCount = 1;
+
+    return vkCreateImageView(vk_device_, &createInfo, GpuHostCallbacks(), &view) == VK_SUCCESS;
+}
+
+bool GpuResource::_CreateOffscreenTargets(const VkExtent2D& extent, uint32_t image_count)
+{
+    image_count = std::max(image_count, 1u);
+    vk_swapchain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+    vk_swapchain_image_extent = extent;
+    // 渲染完成后可直接拷贝回读
+    vk_target_layout_ = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    vk_swapchain_image_usage_ = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    vk_swapchain_images_.resize(image_count, VK_NULL_HANDLE);
+    offscreen_images_.resize(image_count);
+    offscreen_residency_.assign(image_count, 0);
+    for (uint32_t i = 0; i < image_count; i++)
+    {
+        CHECK_OR_RETURN_FALSE(_CreateOffscreenImage(GpuMemoryUsage::kDeviceOnly, offscreen_images_[i]))
+        vk_swapchain_images_[i] = offscreen_images_[i].vk_image;
+    }
+
+    return true;
+}
+
+bool GpuResource::_CreateOffscreenImage(GpuMemoryUsage usage, GpuImage& image)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = vk_swapchain_image_format;
+    imageInfo.extent = { vk_swapchain_image_extent.width, vk_swapchain_image_extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = vk_swapchain_image_usage_;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    return allocator_.CreateImage(imageInfo, usage, image);
+}
+
+void GpuResource::_RegisterOffscreenTarget(uint32_t index)
+{
+    // 统一内存没有可以降级的位置, 系统内存里的图片也不需要再驱逐
+    uint32_t heap_index = vk_memory_properties_.memoryTypes[offscreen_images_[index].allocation.memory_type].heapIndex;
+    if (allocator_.IsUnifiedMemory() || !(vk_memory_properties_.memoryHeaps[heap_index].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+    {
+        offscreen_residency_[index] = 0;
+        return;
+    }
+    offscreen_residency_[index] = residency_.Register(heap_index, offscreen_images_[index].allocation.size,
+        [this, index]() { _DemoteOffscreenTarget(index); });
+}
+
+void GpuResource::_DemoteOffscreenTarget(uint32_t index)
+{
+    // 在渲染线程的驻留更新中调用, 该图片最后一次使用已经完成. 先建新图片, 失败时保留原图片
+    offscreen_residency_[index] = 0;
+    GpuImage image;
+    VkImageView view = VK_NULL_HANDLE;
+    if (!_CreateOffscreenImage(GpuMemoryUsage::kDemoted, image) || !_CreateImageView(image.vk_image, view))
+    {
+        fmt::print("offscreen target {}: no system memory to demote to\n", index);
+        allocator_.DestroyImage(image);
+        return;
+    }
+
+    // 旧帧缓冲可能仍引用旧视图, 与它们同批释放
+    uint64_t retire_value = graphics_timeline_.PendingValue() + 1;
+    GpuAllocator* allocator = &allocator_;
+    VkDevice device = vk_device_;
+    deletion_queue_.Push(retire_value, [allocator, device, old_image = offscreen_images_[index], old_view = vk_swapchain_image_views[index]]() mutable {
+        vkDestroyImageView(device, old_view, GpuHostCallbacks());
+        allocator->DestroyImage(old_image);
+    });
+
+    offscreen_images_[index] = image;
+    vk_swapchain_images_[index] = image.vk_image;
+    vk_swapchain_image_views[index] = view;
+    render_targets_changed_ = true;
+    fmt::print("offscreen target {} demoted to system memory\n", index);
+}
+
+void GpuResource::TouchRenderTarget(uint32_t index, uint64_t timeline_value)
+{
+    if (index < offscreen_residency_.size() && offscreen_residency_[index] != 0)
+    {
+        residency_.Touch(offscreen_residency_[index], timeline_value);
+    }
+}
+
+bool GpuResource::TakeRenderTargetsChanged()
+{
+    bool changed = render_targets_changed_;
+    render_targets_changed_ = false;
+    return changed;
+}
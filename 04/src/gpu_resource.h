@@ -1,84 +1,183 @@
-#pragma once
-
-#include <optional>
-#include <string>
-#include <vector>
-#include <vulkan/vulkan.hpp>
-#include <SDL2/SDL_video.h>
-
-struct QueueFamilyIndices {
-	std::optional<uint32_t> graphicsFamily;
-	std::optional<uint32_t> presentFamily;
-
-	bool isComplete()
-	{
-		return graphicsFamily.has_value() && presentFamily.has_value();
-	}
-};
-
-struct SwapChainSupportDetails 
-{
-	VkSurfaceCapabilitiesKHR capabilities;
-	std::vector<VkSurfaceFormatKHR> formats;
-	std::vector<VkPresentModeKHR> presentModes;
-};
-
-/**
- * @brief 该类管理一些通用资源 
- */
-class GpuResource final
-{
-public:
-	GpuResource() = default;
-	~GpuResource();
-
-	bool Init(SDL_Window* parent_window);
-	void UnInit();
-
-private:
-	bool _CreateInstatce();
-	bool _SetupDebugMessenger();
-	bool _CheckValidationLayerSupport();
-	void _PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
-	bool _IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
-	bool _PickPhysicalDevice();
-	QueueFamilyIndices _FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
-
-	// 创建逻辑设备 和 窗体表面
-	bool _CreateLogicDevice();
-	bool _CreateSurface();
-	bool _CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::string& extension_name);
-
-	// 交换链创建
-	bool _CreateSwapChain();
-	SwapChainSupportDetails _QuerySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
-	std::optional<VkSurfaceFormatKHR> _ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-	std::optional<VkPresentModeKHR> _ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
-	VkExtent2D _ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-
-	bool _CreateImageViews();
-
-private:
-	SDL_Window* parent_window_ = nullptr;
-	bool is_debug_ = true;
-	std::vector<const char*> validation_layers_ = { "VK_LAYER_KHRONOS_validation" };
-	VkDebugUtilsMessengerEXT vk_debug_messenger_ = VK_NULL_HANDLE;
-
-public:
-	VkInstance vk_instance_ = VK_NULL_HANDLE;	///< vulkan实例
-	VkPhysicalDevice vk_physicaldevice_ = VK_NULL_HANDLE;	///< 显卡设备
-	VkDevice vk_device_ = VK_NULL_HANDLE;	///< 逻辑设备
-	VkQueue vk_graphics_queue_ = VK_NULL_HANDLE;	///< 图形显卡队列
-
-	VkSurfaceKHR vk_surface_ = VK_NULL_HANDLE;	///< 窗体表面
-	VkQueue vk_present_queue_ = VK_NULL_HANDLE;	///< 交换链命令队列
-	VkSwapchainKHR vk_swap_chain_ = VK_NULL_HANDLE;	///< 交换链对象
-	std::vector<VkImage> vk_swapchain_images_;	///< 交换链的后备缓冲
-	VkFormat vk_swapchain_image_format = VK_FORMAT_UNDEFINED;	///< 交换链后备缓冲格式
-	VkExtent2D vk_swapchain_image_extent = { 0, 0 };	///< 交换链后备缓冲宽高
-
-	std::vector<VkImageView> vk_swapchain_image_views;
-
-	int32_t vk_graphics_family_ = -1;
-	int32_t vk_present_family_ = -1;
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <SDL2/SDL_video.h>
+#include "gpu_define.h"
+#include "gpu_allocator.h"
+#include "gpu_deletion_queue.h"
+#include "gpu_pipeline_cache.h"
+#include "gpu_pipeline_compiler.h"
+#include "gpu_pipeline_library.h"
+#include "gpu_residency.h"
+#include "gpu_shader_cache.h"
+#include "gpu_staging_ring.h"
+#include "gpu_upload_engine.h"
+#include "gpu_timeline.h"
+
+struct QueueFamilyIndices {
+	std::optional<uint32_t> graphicsFamily;
+	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily;	///< 只支持传输的队列族, 没有时为空
+
+	bool isComplete()
+	{
+		return graphicsFamily.has_value() && presentFamily.has_value();
+	}
+};
+
+struct SwapChainSupportDetails 
+{
+	VkSurfaceCapabilitiesKHR capabilities;
+	std::vector<VkSurfaceFormatKHR> formats;
+	std::vector<VkPresentModeKHR> presentModes;
+};
+
+/**
+ * @brief 该类管理一些通用资源 
+ */
+class GpuResource final
+{
+public:
+	GpuResource() = default;
+	~GpuResource();
+
+	/**
+	 * @brief 初始化设备和渲染目标
+	 * @param parent_window 窗口, 无窗口模式下可以为空
+	 */
+	bool Init(SDL_Window* parent_window, const GpuConfig& config);
+	void UnInit();
+
+	bool IsHeadless() const { return headless_; }
+
+	/**
+	 * @brief 是否使用动态渲染 (1.3 核心或 VK_KHR_dynamic_rendering), 否则走渲染通道和帧缓冲
+	 */
+	bool UseDynamicRendering() const { return dynamic_rendering_; }
+
+	/**
+	 * @brief 是否开启无图片帧缓冲 (1.2 核心), 渲染通道路径下所有交换链图片共用一个帧缓冲
+	 */
+	bool UseImagelessFramebuffer() const { return imageless_framebuffer_; }
+
+	/**
+	 * @brief 显卡限制 (nonCoherentAtomSize, 各类对齐等), 选择显卡时缓存
+	 */
+	const VkPhysicalDeviceLimits& GetLimits() const { return vk_physicaldevice_properties_.limits; }
+
+	/**
+	 * @brief 重建交换链
+	 * 旧交换链通过 oldSwapchain 交给驱动复用, 旧交换链和图片视图进入延迟释放队列, 不等待设备空闲
+	 * @return 窗口最小化 (大小为 0) 或创建失败时返回 false, 需要稍后重试
+	 */
+	bool RecreateSwapChain();
+
+	/**
+	 * @brief 设置呈现策略, 下次重建交换链时生效
+	 */
+	void SetPresentProfile(PresentProfile profile) { present_profile_ = profile; }
+	PresentProfile GetPresentProfile() const { return present_profile_; }
+
+	/**
+	 * @brief 离屏图片在 timeline_value 这次提交中被使用, 驻留管理按此排 LRU
+	 */
+	void TouchRenderTarget(uint32_t index, uint64_t timeline_value);
+
+	/**
+	 * @brief 离屏图片被驱逐降级到系统内存后返回 true 并清除标记, 调用方需要重建引用图片视图的帧缓冲
+	 */
+	bool TakeRenderTargetsChanged();
+
+private:
+	bool _CreateInstatce();
+	bool _SetupDebugMessenger();
+	bool _CheckValidationLayerSupport();
+	void _PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
+	bool _IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
+	bool _PickPhysicalDevice();
+	QueueFamilyIndices _FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
+
+	// 创建逻辑设备 和 窗体表面
+	bool _CreateLogicDevice();
+	bool _CreateSurface();
+	bool _CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::string& extension_name);
+	bool _CheckTimelineSemaphoreSupport(VkPhysicalDevice device);
+	bool _CheckDynamicRenderingSupport(VkPhysicalDevice device);
+	bool _CheckImagelessFramebufferSupport(VkPhysicalDevice device);
+
+	// 交换链创建
+	bool _CreateSwapChain(VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
+	SwapChainSupportDetails _QuerySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
+	std::optional<VkSurfaceFormatKHR> _ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
+	std::optional<VkPresentModeKHR> _ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+	uint32_t _ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR present_mode);
+	VkExtent2D _ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+
+	bool _CreateImageViews();
+	bool _CreateImageView(VkImage image, VkImageView& view);
+
+	// 无窗口模式的离屏渲染目标
+	bool _CreateOffscreenTargets(const VkExtent2D& extent, uint32_t image_count);
+	bool _CreateOffscreenImage(GpuMemoryUsage usage, GpuImage& image);
+	/**
+	 * @brief 位于显存的离屏图片登记到驻留管理, 驱逐时在系统内存重建
+	 */
+	void _RegisterOffscreenTarget(uint32_t index);
+	void _DemoteOffscreenTarget(uint32_t index);
+
+private:
+	SDL_Window* parent_window_ = nullptr;
+	bool headless_ = false;
+	PresentProfile present_profile_ = PresentProfile::kBalanced;
+	bool is_debug_ = false;	///< 是否开启校验层, 由 GpuConfig::validation 决定
+	std::vector<const char*> validation_layers_ = { "VK_LAYER_KHRONOS_validation" };
+	VkDebugUtilsMessengerEXT vk_debug_messenger_ = VK_NULL_HANDLE;
+
+public:
+	VkInstance vk_instance_ = VK_NULL_HANDLE;	///< vulkan实例
+	VkPhysicalDevice vk_physicaldevice_ = VK_NULL_HANDLE;	///< 显卡设备
+	VkDevice vk_device_ = VK_NULL_HANDLE;	///< 逻辑设备
+	VkQueue vk_graphics_queue_ = VK_NULL_HANDLE;	///< 图形显卡队列
+	VkQueue vk_transfer_queue_ = VK_NULL_HANDLE;	///< 传输队列, 没有独立传输队列族时等于图形队列
+
+	VkSurfaceKHR vk_surface_ = VK_NULL_HANDLE;	///< 窗体表面
+	VkQueue vk_present_queue_ = VK_NULL_HANDLE;	///< 交换链命令队列
+	VkSwapchainKHR vk_swap_chain_ = VK_NULL_HANDLE;	///< 交换链对象
+	std::vector<VkImage> vk_swapchain_images_;	///< 交换链的后备缓冲
+	VkFormat vk_swapchain_image_format = VK_FORMAT_UNDEFINED;	///< 交换链后备缓冲格式
+	VkExtent2D vk_swapchain_image_extent = { 0, 0 };	///< 交换链后备缓冲宽高
+	VkImageUsageFlags vk_swapchain_image_usage_ = 0;	///< 后备缓冲的用途, 无图片帧缓冲需要与之一致
+	VkPresentModeKHR vk_present_mode_ = VK_PRESENT_MODE_FIFO_KHR;	///< 当前呈现模式
+
+	std::vector<VkImageView> vk_swapchain_image_views;
+	std::vector<GpuImage> offscreen_images_;	///< 无窗口模式下的离屏图片
+	std::vector<GpuResidency::ResidencyId> offscreen_residency_;	///< 离屏图片的驻留登记, 0 表示未登记
+	bool render_targets_changed_ = false;	///< 离屏图片已重建, 图片视图随之改变
+	VkImageLayout vk_target_layout_ = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;	///< 渲染结束后目标图片的布局
+
+	int32_t vk_graphics_family_ = -1;
+	int32_t vk_present_family_ = -1;
+	int32_t vk_transfer_family_ = -1;
+
+	uint32_t vk_device_api_version_ = VK_API_VERSION_1_0;	///< 显卡支持的 vulkan 版本
+	VkPhysicalDeviceProperties vk_physicaldevice_properties_{};	///< 显卡属性和限制
+	VkPhysicalDeviceMemoryProperties vk_memory_properties_{};	///< 内存堆和内存类型
+	GpuTimeline graphics_timeline_;	///< 图形队列进度计数
+	GpuDeletionQueue deletion_queue_;	///< 按图形队列 timeline 延迟释放资源
+	GpuAllocator allocator_;	///< 显存子分配器, buffer 和图片的显存都从这里申请
+	GpuResidency residency_;	///< 堆预算跟踪和 LRU 驱逐
+	bool memory_budget_supported_ = false;	///< 是否开启 VK_EXT_memory_budget
+	bool dynamic_rendering_ = false;	///< 是否开启动态渲染, 初始化时为配置的请求值
+	PFN_vkCmdBeginRendering vk_cmd_begin_rendering_ = nullptr;	///< 1.3 核心或 KHR 扩展版本
+	PFN_vkCmdEndRendering vk_cmd_end_rendering_ = nullptr;
+	bool imageless_framebuffer_ = false;	///< 是否开启 imagelessFramebuffer
+	GpuStagingRing staging_ring_;	///< 上传暂存环, 按图形队列 timeline 回收
+	GpuUploadEngine upload_engine_;	///< 异步上传, 优先使用独立传输队列
+	GpuShaderCache shader_cache_;	///< 按内容哈希去重的着色器模块
+	GpuPipelineCache pipeline_cache_;	///< 管线缓存, 启动时从磁盘读取, 退出和定期写回
+	GpuPipelineCompiler pipeline_compiler_;	///< 管线编译线程池
+	GpuPipelineLibrary pipeline_library_;	///< 按状态哈希去重的渲染通道, 布局和管线
 };
\ No newline at end of file
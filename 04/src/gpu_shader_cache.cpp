@@ -0,0 +1,148 @@
+#include "gpu_shader_cache.h"
+
+#include <cstring>
+#include <fmt/format.h>
+#include "gpu_hash.h"
+#include "gpu_host_allocator.h"
+#include "gpu_mapped_file.h"
+
+GpuShaderCache::~GpuShaderCache()
+{
+    UnInit();
+}
+
+bool GpuShaderCache::Init(VkDevice device)
+{
+    vk_device_ = device;
+    return true;
+}
+
+void GpuShaderCache::UnInit()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [hash, entry] : modules_)
+    {
+        if (entry.ref_count > 0)
+        {
+            fmt::print("shader module {:016x} still has {} references\n", hash, entry.ref_count);
+        }
+        vkDestroyShaderModule(vk_device_, entry.vk_module, GpuHostCallbacks());
+    }
+    modules_.clear();
+}
+
+std::optional<GpuShaderModule> GpuShaderCache::Load(const std::string& path)
+{
+    // 模块创建后驱动已持有自己的副本, 映射在返回前解除
+    GpuMappedFile file;
+    if (!file.Open(path))
+    {
+        return {};
+    }
+    return _Acquire(file.Data(), file.Size(), std::nullopt, path.c_str());
+}
+
+std::optional<GpuShaderModule> GpuShaderCache::Acquire(const void* code, size_t size)
+{
+    return _Acquire(code, size, std::nullopt, "memory");
+}
+
+std::optional<GpuShaderModule> GpuShaderCache::Acquire(const GpuEmbeddedShader& shader)
+{
+    return _Acquire(shader.code, shader.size, shader.hash, shader.source);
+}
+
+void GpuShaderCache::Release(const GpuShaderModule& module)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = modules_.find(module.hash);
+    if (iter == modules_.end() || iter->second.vk_module != module.vk_module)
+    {
+        return;
+    }
+
+    if (--iter->second.ref_count == 0)
+    {
+        vkDestroyShaderModule(vk_device_, iter->second.vk_module, GpuHostCallbacks());
+        modules_.erase(iter);
+    }
+}
+
+size_t GpuShaderCache::ModuleCount()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return modules_.size();
+}
+
+bool GpuShaderCache::Validate(const void* code, size_t size)
+{
+    if (code == nullptr || size < sizeof(uint32_t) * 5 || size % sizeof(uint32_t) != 0)
+    {
+        return false;
+    }
+    // pCode 是 uint32_t 数组, 映射地址按页对齐, 内存中的数据需要调用方保证
+    if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0)
+    {
+        return false;
+    }
+    // 字节序相反的魔数说明是另一种端序生成的文件, vulkan 不接受
+    uint32_t magic = 0;
+    std::memcpy(&magic, code, sizeof(magic));
+    return magic == kSpirvMagic;
+}
+
+std::optional<GpuShaderModule> GpuShaderCache::_Acquire(const void* code, size_t size, std::optional<uint64_t> hash, const char* name)
+{
+    if (!Validate(code, size))
+    {
+        fmt::print("{} is not a valid SPIR-V module\n", name);
+        return {};
+    }
+
+    GpuShaderModule module;
+    module.hash = hash ? hash.value() : GpuHash(code, size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = modules_.find(module.hash);
+    if (iter != modules_.end())
+    {
+        if (iter->second.size != size)
+        {
+            // 64 位哈希冲突几乎不会发生, 发生时拒绝而不是返回错误的模块
+            fmt::print("shader hash collision: {} ({:016x})\n", name, module.hash);
+            return {};
+        }
+        iter->second.ref_count++;
+        module.vk_module = iter->second.vk_module;
+        module.reflection = iter->second.reflection;
+        return module;
+    }
+
+    // 接口解析失败的模块无法生成布局, 不创建
+    auto reflection = std::make_shared<GpuShaderReflection>();
+    if (!reflection->Parse(code, size))
+    {
+        fmt::print("reflect {} failed\n", name);
+        return {};
+    }
+    module.reflection = reflection;
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode = static_cast<const uint32_t*>(code);
+    VkResult ret = vkCreateShaderModule(vk_device_, &createInfo, GpuHostCallbacks(), &module.vk_module);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateShaderModule {} return error: {}\n", name, ret);
+        return {};
+    }
+
+    Entry entry;
+    entry.vk_module = module.vk_module;
+    entry.reflection = module.reflection;
+    entry.size = size;
+    entry.ref_count = 1;
+    modules_.emplace(module.hash, entry);
+    return module;
+}
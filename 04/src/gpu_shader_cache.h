@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vulkan/vulkan.hpp>
+#include "gpu_embedded_shader.h"
+#include "gpu_shader_reflect.h"
+
+/**
+ * @brief 缓存中的着色器模块, hash 为 SPIR-V 内容哈希, 可直接用作管线键
+ */
+struct GpuShaderModule
+{
+    VkShaderModule vk_module = VK_NULL_HANDLE;
+    uint64_t hash = 0;
+    std::shared_ptr<const GpuShaderReflection> reflection;  ///< 着色器接口, 相同内容只解析一次
+};
+
+/**
+ * @brief 按内容哈希去重的着色器模块缓存
+ * SPIR-V 文件通过内存映射读入, 检查对齐和魔数后直接交给驱动, 不再拷贝到 vector.
+ * 相同内容只创建一个模块并反射一次接口, 多个管线共用, 引用计数归零时销毁. 线程安全
+ */
+class GpuShaderCache final
+{
+public:
+    GpuShaderCache() = default;
+    ~GpuShaderCache();
+
+    GpuShaderCache(const GpuShaderCache&) = delete;
+    GpuShaderCache& operator=(const GpuShaderCache&) = delete;
+
+    bool Init(VkDevice device);
+
+    /**
+     * @brief 销毁全部模块, 仍有引用时打印提示
+     */
+    void UnInit();
+
+    /**
+     * @brief 映射 SPIR-V 文件并取得模块, 引用计数加一
+     */
+    std::optional<GpuShaderModule> Load(const std::string& path);
+
+    /**
+     * @brief 从内存中的 SPIR-V 取得模块, code 需按 4 字节对齐
+     */
+    std::optional<GpuShaderModule> Acquire(const void* code, size_t size);
+
+    /**
+     * @brief 从构建时嵌入的 SPIR-V 取得模块, 直接使用编译期算好的哈希
+     */
+    std::optional<GpuShaderModule> Acquire(const GpuEmbeddedShader& shader);
+
+    /**
+     * @brief 引用计数减一, 归零时销毁模块, 调用前需保证使用该模块的管线已编译结束
+     */
+    void Release(const GpuShaderModule& module);
+
+    size_t ModuleCount();
+
+    /**
+     * @brief 检查长度, 对齐和 SPIR-V 魔数
+     */
+    static bool Validate(const void* code, size_t size);
+
+private:
+    struct Entry
+    {
+        VkShaderModule vk_module = VK_NULL_HANDLE;
+        std::shared_ptr<const GpuShaderReflection> reflection;
+        size_t size = 0;
+        uint32_t ref_count = 0;
+    };
+
+    /**
+     * @param hash 为空时按内容计算
+     */
+    std::optional<GpuShaderModule> _Acquire(const void* code, size_t size, std::optional<uint64_t> hash, const char* name);
+
+private:
+    static constexpr uint32_t kSpirvMagic = 0x07230203;
+
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> modules_;
+};
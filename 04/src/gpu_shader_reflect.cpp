@@ -0,0 +1,697 @@
+#include "gpu_shader_reflect.h"
+
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+
+namespace {
+// SPIR-V 规范中的操作码和枚举值, 只列出用到的部分
+constexpr uint32_t kOpEntryPoint = 15;
+constexpr uint32_t kOpTypeInt = 21;
+constexpr uint32_t kOpTypeFloat = 22;
+constexpr uint32_t kOpTypeVector = 23;
+constexpr uint32_t kOpTypeMatrix = 24;
+constexpr uint32_t kOpTypeImage = 25;
+constexpr uint32_t kOpTypeSampler = 26;
+constexpr uint32_t kOpTypeSampledImage = 27;
+constexpr uint32_t kOpTypeArray = 28;
+constexpr uint32_t kOpTypeRuntimeArray = 29;
+constexpr uint32_t kOpTypeStruct = 30;
+constexpr uint32_t kOpTypePointer = 32;
+constexpr uint32_t kOpConstant = 43;
+constexpr uint32_t kOpSpecConstant = 50;
+constexpr uint32_t kOpVariable = 59;
+constexpr uint32_t kOpDecorate = 71;
+constexpr uint32_t kOpMemberDecorate = 72;
+constexpr uint32_t kOpTypeAccelerationStructure = 5341;
+
+constexpr uint32_t kDecorationBufferBlock = 3;
+constexpr uint32_t kDecorationArrayStride = 6;
+constexpr uint32_t kDecorationMatrixStride = 7;
+constexpr uint32_t kDecorationBuiltIn = 11;
+constexpr uint32_t kDecorationLocation = 30;
+constexpr uint32_t kDecorationBinding = 33;
+constexpr uint32_t kDecorationDescriptorSet = 34;
+constexpr uint32_t kDecorationOffset = 35;
+
+constexpr uint32_t kStorageUniformConstant = 0;
+constexpr uint32_t kStorageInput = 1;
+constexpr uint32_t kStorageUniform = 2;
+constexpr uint32_t kStoragePushConstant = 9;
+constexpr uint32_t kStorageStorageBuffer = 12;
+
+constexpr uint32_t kDimBuffer = 5;
+constexpr uint32_t kDimSubpassData = 6;
+
+constexpr uint32_t kHeaderWords = 5;
+constexpr uint32_t kMaxTypeDepth = 32;  ///< 类型嵌套上限, 防止损坏的文件导致无限递归
+constexpr uint32_t kMaxStructMembers = 16383;   ///< SPIR-V 通用限制中结构体成员数的上限
+constexpr uint32_t kMaxVertexLocations = 256;   ///< 顶点输入 location 上限, 防止超长数组展开过多
+constexpr uint32_t kUnset = ~0u;
+
+constexpr std::array<VkFormat, 4> kFloatFormats = {
+    VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+constexpr std::array<VkFormat, 4> kIntFormats = {
+    VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+constexpr std::array<VkFormat, 4> kUintFormats = {
+    VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+constexpr std::array<VkFormat, 4> kDoubleFormats = {
+    VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT };
+
+/**
+ * @brief 一个 id 的定义指令和装饰
+ */
+struct IdInfo
+{
+    const uint32_t* inst = nullptr;     ///< 定义该 id 的类型或常量指令
+    uint32_t location = kUnset;
+    uint32_t binding = kUnset;
+    uint32_t set = kUnset;
+    uint32_t array_stride = 0;
+    bool builtin = false;               ///< 变量或结构体成员带 BuiltIn 装饰
+    bool buffer_block = false;
+    std::vector<uint32_t> member_offsets;
+    std::vector<uint32_t> member_matrix_strides;
+};
+
+uint32_t Opcode(const uint32_t* inst)
+{
+    return inst[0] & 0xffff;
+}
+
+uint32_t WordCount(const uint32_t* inst)
+{
+    return inst[0] >> 16;
+}
+
+VkShaderStageFlags ExecutionModelStage(uint32_t model)
+{
+    switch (model)
+    {
+    case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    default: return 0;
+    }
+}
+
+void SetMember(std::vector<uint32_t>& values, uint32_t member, uint32_t value)
+{
+    // 调用方已检查 member < kMaxStructMembers
+    if (member >= values.size())
+    {
+        values.resize(member + 1, kUnset);
+    }
+    values[member] = value;
+}
+
+/**
+ * @brief 加入一个绑定, 已存在时合并阶段和数组长度
+ */
+bool AddBinding(std::vector<GpuDescriptorBinding>& bindings, const GpuDescriptorBinding& binding)
+{
+    auto iter = std::lower_bound(bindings.begin(), bindings.end(), binding,
+        [](const GpuDescriptorBinding& a, const GpuDescriptorBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+    if (iter == bindings.end() || iter->set != binding.set || iter->binding != binding.binding)
+    {
+        bindings.insert(iter, binding);
+        return true;
+    }
+
+    if (iter->type != binding.type)
+    {
+        fmt::print("descriptor set {} binding {} has conflicting types {} and {}\n",
+            binding.set, binding.binding, static_cast<int>(iter->type), static_cast<int>(binding.type));
+        return false;
+    }
+    iter->count = std::max(iter->count, binding.count);
+    iter->stages |= binding.stages;
+    return true;
+}
+
+class Parser
+{
+public:
+    Parser(const uint32_t* words, size_t word_count)
+        : words_(words), word_count_(word_count)
+    {
+    }
+
+    bool Run(GpuShaderReflection& reflection)
+    {
+        if (!_Scan())
+        {
+            return false;
+        }
+
+        reflection = GpuShaderReflection();
+        reflection.stage = stage_;
+        for (const uint32_t* inst : variables_)
+        {
+            if (!_AddVariable(inst, reflection))
+            {
+                return false;
+            }
+        }
+
+        std::sort(reflection.vertex_inputs.begin(), reflection.vertex_inputs.end(),
+            [](const GpuVertexInput& a, const GpuVertexInput& b) { return a.location < b.location; });
+        return true;
+    }
+
+private:
+    bool _Scan()
+    {
+        uint32_t bound = words_[3];
+        // bound 是所有 id 的上界, 远大于文件长度说明文件已损坏
+        if (bound > word_count_)
+        {
+            fmt::print("SPIR-V id bound {} is out of range\n", bound);
+            return false;
+        }
+        ids_.resize(bound);
+
+        size_t offset = kHeaderWords;
+        while (offset < word_count_)
+        {
+            const uint32_t* inst = words_ + offset;
+            uint32_t count = WordCount(inst);
+            if (count == 0 || offset + count > word_count_)
+            {
+                fmt::print("SPIR-V instruction at word {} is truncated\n", offset);
+                return false;
+            }
+            if (!_ScanInstruction(inst, count))
+            {
+                return false;
+            }
+            offset += count;
+        }
+
+        if (stage_ == 0)
+        {
+            fmt::print("SPIR-V has no supported entry point\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool _ScanInstruction(const uint32_t* inst, uint32_t count)
+    {
+        switch (Opcode(inst))
+        {
+        case kOpEntryPoint:
+            // 多个入口点时只反射第一个
+            if (count >= 3 && stage_ == 0)
+            {
+                stage_ = ExecutionModelStage(inst[1]);
+            }
+            return true;
+        case kOpTypeInt:
+        case kOpTypeFloat:
+        case kOpTypeVector:
+        case kOpTypeMatrix:
+        case kOpTypeImage:
+        case kOpTypeSampler:
+        case kOpTypeSampledImage:
+        case kOpTypeArray:
+        case kOpTypeRuntimeArray:
+        case kOpTypeStruct:
+        case kOpTypePointer:
+        case kOpTypeAccelerationStructure:
+            return _Define(inst, count, 1);
+        case kOpConstant:
+        case kOpSpecConstant:
+            return _Define(inst, count, 2);
+        case kOpVariable:
+            if (count < 4 || !_Define(inst, count, 2))
+            {
+                return false;
+            }
+            variables_.push_back(inst);
+            return true;
+        case kOpDecorate:
+            if (count >= 3)
+            {
+                IdInfo* info = _Info(inst[1]);
+                if (info == nullptr)
+                {
+                    return false;
+                }
+                _Decorate(*info, inst[2], count >= 4 ? inst[3] : 0);
+            }
+            return true;
+        case kOpMemberDecorate:
+            if (count >= 4)
+            {
+                IdInfo* info = _Info(inst[1]);
+                if (info == nullptr)
+                {
+                    return false;
+                }
+                return _MemberDecorate(*info, inst[2], inst[3], count >= 5 ? inst[4] : 0);
+            }
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    bool _Define(const uint32_t* inst, uint32_t count, uint32_t result_word)
+    {
+        IdInfo* info = count > result_word ? _Info(inst[result_word]) : nullptr;
+        if (info == nullptr)
+        {
+            return false;
+        }
+        info->inst = inst;
+        return true;
+    }
+
+    void _Decorate(IdInfo& info, uint32_t decoration, uint32_t value)
+    {
+        switch (decoration)
+        {
+        case kDecorationBufferBlock: info.buffer_block = true; break;
+        case kDecorationArrayStride: info.array_stride = value; break;
+        case kDecorationBuiltIn: info.builtin = true; break;
+        case kDecorationLocation: info.location = value; break;
+        case kDecorationBinding: info.binding = value; break;
+        case kDecorationDescriptorSet: info.set = value; break;
+        default: break;
+        }
+    }
+
+    bool _MemberDecorate(IdInfo& info, uint32_t member, uint32_t decoration, uint32_t value)
+    {
+        // 装饰在类型定义之前, 还不知道成员数, 按固定上限拒绝, 避免损坏的文件 (如热重载时写了一半) 申请巨大的数组
+        if (member >= kMaxStructMembers)
+        {
+            fmt::print("SPIR-V member index {} is out of range\n", member);
+            return false;
+        }
+
+        switch (decoration)
+        {
+        case kDecorationOffset: SetMember(info.member_offsets, member, value); break;
+        case kDecorationMatrixStride: SetMember(info.member_matrix_strides, member, value); break;
+        // gl_PerVertex 之类的内建块不是用户接口
+        case kDecorationBuiltIn: info.builtin = true; break;
+        default: break;
+        }
+        return true;
+    }
+
+    IdInfo* _Info(uint32_t id)
+    {
+        if (id >= ids_.size())
+        {
+            fmt::print("SPIR-V id {} is out of range\n", id);
+            return nullptr;
+        }
+        return &ids_[id];
+    }
+
+    /**
+     * @brief 取得类型定义指令, 操作数不足时返回空
+     */
+    const uint32_t* _Type(uint32_t id, uint32_t min_words) const
+    {
+        if (id >= ids_.size() || ids_[id].inst == nullptr || WordCount(ids_[id].inst) < min_words)
+        {
+            return nullptr;
+        }
+        return ids_[id].inst;
+    }
+
+    uint32_t _ConstantValue(uint32_t id) const
+    {
+        const uint32_t* inst = _Type(id, 4);
+        if (inst == nullptr || (Opcode(inst) != kOpConstant && Opcode(inst) != kOpSpecConstant))
+        {
+            return 0;
+        }
+        return inst[3];
+    }
+
+    bool _AddVariable(const uint32_t* inst, GpuShaderReflection& reflection)
+    {
+        const IdInfo& info = ids_[inst[2]];
+        uint32_t storage = inst[3];
+        const uint32_t* pointer = _Type(inst[1], 4);
+        if (pointer == nullptr || Opcode(pointer) != kOpTypePointer)
+        {
+            // 函数内的变量等不影响接口
+            return true;
+        }
+        uint32_t type_id = pointer[3];
+
+        switch (storage)
+        {
+        case kStorageInput:
+        {
+            if (stage_ != VK_SHADER_STAGE_VERTEX_BIT || info.builtin || type_id >= ids_.size() || ids_[type_id].builtin)
+            {
+                return true;
+            }
+            if (info.location == kUnset)
+            {
+                fmt::print("vertex input {} has no location\n", inst[2]);
+                return false;
+            }
+            uint32_t location = info.location;
+            return _AddVertexInput(type_id, location, reflection, 0);
+        }
+        case kStorageUniformConstant:
+        case kStorageUniform:
+        case kStorageStorageBuffer:
+            // 没有绑定号的变量在 vulkan 中不能作为描述符使用
+            if (info.binding == kUnset)
+            {
+                return true;
+            }
+            return _AddDescriptor(info, type_id, storage, reflection);
+        case kStoragePushConstant:
+            return _SetPushConstants(type_id, reflection);
+        default:
+            return true;
+        }
+    }
+
+    bool _AddVertexInput(uint32_t type_id, uint32_t& location, GpuShaderReflection& reflection, uint32_t depth)
+    {
+        const uint32_t* type = _Type(type_id, 3);
+        if (type == nullptr || depth > kMaxTypeDepth || location >= kMaxVertexLocations)
+        {
+            return false;
+        }
+
+        uint32_t op = Opcode(type);
+        if (op == kOpTypeArray || op == kOpTypeMatrix)
+        {
+            // 数组的长度和矩阵的列数都在第 4 个字
+            if (WordCount(type) < 4)
+            {
+                return false;
+            }
+            // 数组的每个元素, 矩阵的每一列各占 location
+            uint32_t length = op == kOpTypeArray ? _ConstantValue(type[3]) : type[3];
+            for (uint32_t i = 0; i < length; i++)
+            {
+                if (!_AddVertexInput(type[2], location, reflection, depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        uint32_t component_count = 1;
+        const uint32_t* component = type;
+        if (op == kOpTypeVector)
+        {
+            component_count = WordCount(type) >= 4 ? type[3] : 0;
+            component = _Type(type[2], 3);
+        }
+        if (component == nullptr || component_count == 0 || component_count > 4)
+        {
+            return false;
+        }
+
+        uint32_t width = component[2];
+        const std::array<VkFormat, 4>* formats = nullptr;
+        if (Opcode(component) == kOpTypeFloat && width == 32)
+        {
+            formats = &kFloatFormats;
+        }
+        else if (Opcode(component) == kOpTypeFloat && width == 64)
+        {
+            formats = &kDoubleFormats;
+        }
+        else if (Opcode(component) == kOpTypeInt && width == 32 && WordCount(component) >= 4)
+        {
+            formats = component[3] != 0 ? &kIntFormats : &kUintFormats;
+        }
+        if (formats == nullptr)
+        {
+            fmt::print("vertex input at location {} has an unsupported type\n", location);
+            return false;
+        }
+
+        GpuVertexInput input;
+        input.location = location;
+        input.format = (*formats)[component_count - 1];
+        input.size = component_count * width / 8;
+        reflection.vertex_inputs.push_back(input);
+        // dvec3 和 dvec4 占两个 location
+        location += input.size > 16 ? 2 : 1;
+        return true;
+    }
+
+    bool _AddDescriptor(const IdInfo& info, uint32_t type_id, uint32_t storage, GpuShaderReflection& reflection)
+    {
+        GpuDescriptorBinding binding;
+        binding.set = info.set != kUnset ? info.set : 0;
+        binding.binding = info.binding;
+        binding.stages = stage_;
+
+        const uint32_t* type = _Type(type_id, 2);
+        for (uint32_t depth = 0; type != nullptr && Opcode(type) == kOpTypeArray && depth < kMaxTypeDepth; depth++)
+        {
+            binding.count *= WordCount(type) >= 4 ? _ConstantValue(type[3]) : 0;
+            type = _Type(type[2], 2);
+        }
+        if (type == nullptr)
+        {
+            return false;
+        }
+
+        uint32_t op = Opcode(type);
+        if (op == kOpTypeRuntimeArray)
+        {
+            // 变长描述符数组需要 descriptor indexing, 暂不支持
+            fmt::print("descriptor set {} binding {} is a runtime array\n", binding.set, binding.binding);
+            return false;
+        }
+
+        if (storage == kStorageStorageBuffer)
+        {
+            binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+        else if (storage == kStorageUniform)
+        {
+            // 旧版本 SPIR-V 的存储缓冲是 Uniform + BufferBlock
+            binding.type = ids_[type[1]].buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+        else if (op == kOpTypeSampler)
+        {
+            binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        }
+        else if (op == kOpTypeSampledImage)
+        {
+            binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+        else if (op == kOpTypeImage && WordCount(type) >= 9)
+        {
+            uint32_t dim = type[3];
+            uint32_t sampled = type[7];     // 1: 采样, 2: 存储
+            if (dim == kDimBuffer)
+            {
+                binding.type = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            }
+            else if (dim == kDimSubpassData)
+            {
+                binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            }
+            else {
+                binding.type = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+        }
+        else if (op == kOpTypeAccelerationStructure)
+        {
+            binding.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        }
+        else {
+            fmt::print("descriptor set {} binding {} has an unsupported type\n", binding.set, binding.binding);
+            return false;
+        }
+
+        return AddBinding(reflection.bindings, binding);
+    }
+
+    bool _SetPushConstants(uint32_t type_id, GpuShaderReflection& reflection)
+    {
+        const uint32_t* type = _Type(type_id, 2);
+        if (type == nullptr || Opcode(type) != kOpTypeStruct)
+        {
+            return false;
+        }
+
+        // 不同阶段的推送常量块通常从各自的偏移开始, 范围从第一个成员算起
+        const IdInfo& info = ids_[type_id];
+        uint32_t begin = info.member_offsets.empty() ? 0 : kUnset;
+        for (uint32_t offset : info.member_offsets)
+        {
+            begin = std::min(begin, offset);
+        }
+        uint32_t end = _TypeSize(type_id, 0);
+        if (end <= begin)
+        {
+            return true;
+        }
+
+        reflection.push_constants.stageFlags = stage_;
+        reflection.push_constants.offset = begin;
+        reflection.push_constants.size = end - begin;
+        return true;
+    }
+
+    /**
+     * @brief 按装饰的偏移和步长计算类型大小, 结构体取最后一个成员的结束位置
+     */
+    uint32_t _TypeSize(uint32_t type_id, uint32_t depth) const
+    {
+        const uint32_t* type = _Type(type_id, 2);
+        if (type == nullptr || depth > kMaxTypeDepth)
+        {
+            return 0;
+        }
+
+        uint32_t count = WordCount(type);
+        switch (Opcode(type))
+        {
+        case kOpTypeInt:
+        case kOpTypeFloat:
+            return count >= 3 ? type[2] / 8 : 0;
+        case kOpTypeVector:
+        case kOpTypeMatrix:
+            return count >= 4 ? type[3] * _TypeSize(type[2], depth + 1) : 0;
+        case kOpTypeArray:
+        {
+            if (count < 4)
+            {
+                return 0;
+            }
+            uint32_t stride = ids_[type_id].array_stride;
+            if (stride == 0)
+            {
+                stride = _TypeSize(type[2], depth + 1);
+            }
+            return _ConstantValue(type[3]) * stride;
+        }
+        case kOpTypeStruct:
+        {
+            const IdInfo& info = ids_[type_id];
+            uint32_t end = 0;
+            uint32_t running = 0;
+            for (uint32_t i = 0; i + 2 < count; i++)
+            {
+                uint32_t member_type = type[i + 2];
+                uint32_t offset = i < info.member_offsets.size() && info.member_offsets[i] != kUnset
+                    ? info.member_offsets[i] : running;
+                uint32_t size = _TypeSize(member_type, depth + 1);
+                // 矩阵成员的列间距由 MatrixStride 决定, 可能大于列本身
+                const uint32_t* member = _Type(member_type, 4);
+                if (member != nullptr && Opcode(member) == kOpTypeMatrix
+                    && i < info.member_matrix_strides.size() && info.member_matrix_strides[i] != kUnset)
+                {
+                    size = member[3] * info.member_matrix_strides[i];
+                }
+                running = offset + size;
+                end = std::max(end, running);
+            }
+            return end;
+        }
+        default:
+            return 0;
+        }
+    }
+
+private:
+    const uint32_t* words_ = nullptr;
+    size_t word_count_ = 0;
+    VkShaderStageFlags stage_ = 0;
+    std::vector<IdInfo> ids_;
+    std::vector<const uint32_t*> variables_;
+};
+}
+
+bool GpuShaderReflection::Parse(const void* code, size_t size)
+{
+    if (code == nullptr || size < sizeof(uint32_t) * kHeaderWords)
+    {
+        return false;
+    }
+    Parser parser(static_cast<const uint32_t*>(code), size / sizeof(uint32_t));
+    return parser.Run(*this);
+}
+
+bool GpuShaderReflection::Merge(const GpuShaderReflection& other)
+{
+    stage |= other.stage;
+    if (!other.vertex_inputs.empty())
+    {
+        vertex_inputs = other.vertex_inputs;
+    }
+
+    for (const auto& binding : other.bindings)
+    {
+        if (!AddBinding(bindings, binding))
+        {
+            return false;
+        }
+    }
+
+    // 合并成一个覆盖所有阶段的范围, vkCmdPushConstants 用合并后的阶段一次写入
+    if (other.push_constants.size > 0)
+    {
+        if (push_constants.size == 0)
+        {
+            push_constants = other.push_constants;
+        }
+        else {
+            uint32_t begin = std::min(push_constants.offset, other.push_constants.offset);
+            uint32_t end = std::max(push_constants.offset + push_constants.size, other.push_constants.offset + other.push_constants.size);
+            push_constants.stageFlags |= other.push_constants.stageFlags;
+            push_constants.offset = begin;
+            push_constants.size = end - begin;
+        }
+    }
+    return true;
+}
+
+bool GpuShaderReflection::BuildVertexLayout(GpuVertexLayout& layout) const
+{
+    layout = GpuVertexLayout();
+    if (vertex_inputs.empty())
+    {
+        return true;
+    }
+    if (vertex_inputs.size() > GpuVertexLayout::kMaxAttributes)
+    {
+        fmt::print("too many vertex inputs: {}\n", vertex_inputs.size());
+        return false;
+    }
+
+    uint32_t offset = 0;
+    for (const auto& input : vertex_inputs)
+    {
+        VkVertexInputAttributeDescription& attribute = layout.attributes[layout.attribute_count++];
+        attribute.location = input.location;
+        attribute.binding = 0;
+        attribute.format = input.format;
+        attribute.offset = offset;
+        offset += input.size;
+    }
+
+    layout.binding_count = 1;
+    layout.bindings[0].binding = 0;
+    layout.bindings[0].stride = offset;
+    layout.bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return true;
+}
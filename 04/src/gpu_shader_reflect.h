@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "gpu_pipeline_compiler.h"
+
+/**
+ * @brief 顶点着色器的一个输入, 矩阵和数组按 location 展开
+ */
+struct GpuVertexInput
+{
+    uint32_t location = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t size = 0;      ///< 字节数
+};
+
+/**
+ * @brief 一个描述符绑定, 多个阶段使用同一绑定时 stages 合并
+ */
+struct GpuDescriptorBinding
+{
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uint32_t count = 1;     ///< 数组长度
+    VkShaderStageFlags stages = 0;
+};
+
+/**
+ * @brief 从 SPIR-V 解析出的着色器接口: 顶点输入, 描述符绑定和推送常量
+ * 只读取类型, 变量和装饰指令, 不依赖外部库. 布局由接口生成, 不再手写, 避免与 GLSL 不一致
+ */
+struct GpuShaderReflection
+{
+    VkShaderStageFlags stage = 0;
+    std::vector<GpuVertexInput> vertex_inputs;      ///< 按 location 排序, 只有顶点着色器有
+    std::vector<GpuDescriptorBinding> bindings;     ///< 按 set, binding 排序
+    VkPushConstantRange push_constants{};           ///< size 为 0 表示没有推送常量
+
+    /**
+     * @brief 解析第一个入口点的接口, 调用前需通过 GpuShaderCache::Validate
+     */
+    bool Parse(const void* code, size_t size);
+
+    /**
+     * @brief 合并另一个阶段的接口, 同一绑定在两个阶段中类型不同时返回 false
+     */
+    bool Merge(const GpuShaderReflection& other);
+
+    /**
+     * @brief 顶点输入按 location 顺序交错放在 binding 0, 没有输入时布局为空
+     */
+    bool BuildVertexLayout(GpuVertexLayout& layout) const;
+};
@@ -0,0 +1,122 @@
+#include "gpu_shader_watcher.h"
+
+#include <cstdlib>
+#include <fmt/format.h>
+
+namespace {
+std::filesystem::file_time_type LastWriteTime(const std::string& path)
+{
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(path, ec);
+    return ec ? std::filesystem::file_time_type{} : time;
+}
+}
+
+GpuShaderWatcher::~GpuShaderWatcher()
+{
+    UnInit();
+}
+
+bool GpuShaderWatcher::Init(const std::string& compiler, ChangedCallback callback)
+{
+    compiler_ = compiler;
+    callback_ = std::move(callback);
+    stop_ = false;
+    thread_ = std::thread(&GpuShaderWatcher::_WatchLoop, this);
+    return true;
+}
+
+void GpuShaderWatcher::UnInit()
+{
+    if (!thread_.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    files_.clear();
+    callback_ = nullptr;
+}
+
+void GpuShaderWatcher::Watch(const std::string& spirv_path, const std::string& source_path)
+{
+    WatchedFile file;
+    file.spirv_path = spirv_path;
+    file.spirv_time = LastWriteTime(spirv_path);
+    if (!source_path.empty() && std::filesystem::exists(source_path))
+    {
+        file.source_path = source_path;
+        file.source_time = LastWriteTime(source_path);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.push_back(std::move(file));
+}
+
+void GpuShaderWatcher::_WatchLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, kPollInterval, [this] { return stop_; }))
+    {
+        // 检查和编译都在本线程完成, 持锁期间只有 Watch 会等待
+        for (auto& file : files_)
+        {
+            _CheckFile(file);
+        }
+    }
+}
+
+void GpuShaderWatcher::_CheckFile(WatchedFile& file)
+{
+    if (!file.source_path.empty())
+    {
+        auto source_time = LastWriteTime(file.source_path);
+        if (source_time != file.source_time)
+        {
+            file.source_time = source_time;
+            // 编译成功会更新 SPIR-V 的修改时间, 由下面的检查触发重载
+            _CompileSource(file);
+        }
+    }
+
+    auto spirv_time = LastWriteTime(file.spirv_path);
+    if (spirv_time != file.spirv_time)
+    {
+        file.spirv_time = spirv_time;
+        file.spirv_pending = true;
+        return;
+    }
+
+    if (file.spirv_pending)
+    {
+        file.spirv_pending = false;
+        fmt::print("shader changed: {}\n", file.spirv_path);
+        callback_(file.spirv_path);
+    }
+}
+
+bool GpuShaderWatcher::_CompileSource(const WatchedFile& file)
+{
+    if (compiler_.empty())
+    {
+        return false;
+    }
+
+    std::string command = fmt::format("\"{}\" \"{}\" -o \"{}\"", compiler_, file.source_path, file.spirv_path);
+#ifdef _WIN32
+    // cmd.exe 会去掉首尾的引号, 整条命令再包一层
+    command = "\"" + command + "\"";
+#endif
+    int ret = std::system(command.c_str());
+    if (ret != 0)
+    {
+        // 编译失败保留旧的 SPIR-V, 继续使用当前管线
+        fmt::print("shader compile failed ({}): {}\n", ret, command);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 着色器热重载的文件监视
+ * 后台线程定期比较文件修改时间. 源文件变化时调用 glslc 重新生成 SPIR-V,
+ * SPIR-V 变化并在下一次检查时保持不变 (避免读到写了一半的文件) 后, 在监视线程上回调.
+ * 回调中只应提交后台任务, 渲染线程在帧边界处切换
+ */
+class GpuShaderWatcher final
+{
+public:
+    using ChangedCallback = std::function<void(const std::string& spirv_path)>;
+
+    GpuShaderWatcher() = default;
+    ~GpuShaderWatcher();
+
+    GpuShaderWatcher(const GpuShaderWatcher&) = delete;
+    GpuShaderWatcher& operator=(const GpuShaderWatcher&) = delete;
+
+    /**
+     * @param compiler GLSL 编译器命令, 为空时只监视 SPIR-V
+     */
+    bool Init(const std::string& compiler, ChangedCallback callback);
+    void UnInit();
+
+    /**
+     * @brief 监视一个 SPIR-V 文件, source_path 不为空时同时监视对应的 GLSL 源文件
+     */
+    void Watch(const std::string& spirv_path, const std::string& source_path = std::string());
+
+private:
+    struct WatchedFile
+    {
+        std::string spirv_path;
+        std::string source_path;
+        std::filesystem::file_time_type spirv_time{};
+        std::filesystem::file_time_type source_time{};
+        bool spirv_pending = false;     ///< 修改时间已变化, 等待下一次检查确认写完
+    };
+
+    void _WatchLoop();
+    void _CheckFile(WatchedFile& file);
+    bool _CompileSource(const WatchedFile& file);
+
+private:
+    static constexpr std::chrono::milliseconds kPollInterval{ 250 };
+
+    std::string compiler_;
+    ChangedCallback callback_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<WatchedFile> files_;
+    bool stop_ = false;
+};
@@ -0,0 +1,136 @@
+#include "gpu_staging_ring.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include "gpu_timeline.h"
+
+namespace {
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+GpuStagingRing::~GpuStagingRing()
+{
+    UnInit();
+}
+
+bool GpuStagingRing::Init(VkDevice device, GpuAllocator* allocator, VkDeviceSize size, VkDeviceSize non_coherent_atom_size)
+{
+    vk_device_ = device;
+    allocator_ = allocator;
+    if (!allocator_->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, GpuMemoryUsage::kUpload, buffer_))
+    {
+        return false;
+    }
+    if (buffer_.allocation.mapped == nullptr)
+    {
+        fmt::print("staging ring: buffer is not mapped\n");
+        allocator_->DestroyBuffer(buffer_);
+        return false;
+    }
+
+    size_ = size;
+    bool coherent = buffer_.allocation.property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    atom_size_ = coherent ? 1 : std::max<VkDeviceSize>(non_coherent_atom_size, 1);
+    head_ = tail_ = retired_head_ = 0;
+    fences_.clear();
+    return true;
+}
+
+void GpuStagingRing::UnInit()
+{
+    if (allocator_ != nullptr)
+    {
+        allocator_->DestroyBuffer(buffer_);
+        allocator_ = nullptr;
+    }
+    fences_.clear();
+    vk_device_ = VK_NULL_HANDLE;
+}
+
+bool GpuStagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, GpuStagingRegion& region)
+{
+    // 非一致内存按 atom 对齐, 避免 flush 范围和相邻上传重叠
+    alignment = std::max<VkDeviceSize>({ alignment, atom_size_, 1 });
+    VkDeviceSize aligned_size = AlignUp(size, atom_size_);
+    if (aligned_size > size_)
+    {
+        return false;
+    }
+
+    // 对齐按环内偏移计算, 环大小不必是对齐的整数倍
+    uint64_t lap = head_ - head_ % size_;
+    VkDeviceSize offset = AlignUp(head_ % size_, alignment);
+    // 尾部放不下时跳到下一圈开头, 中间的空隙随本次提交一起回收
+    if (offset + aligned_size > size_)
+    {
+        lap += size_;
+        offset = 0;
+    }
+    uint64_t start = lap + offset;
+    if (start + aligned_size - tail_ > size_)
+    {
+        return false;
+    }
+
+    head_ = start + aligned_size;
+    region.vk_buffer = buffer_.vk_buffer;
+    region.offset = offset;
+    region.size = size;
+    region.mapped = static_cast<uint8_t*>(buffer_.allocation.mapped) + offset;
+    return true;
+}
+
+bool GpuStagingRing::AllocateWait(VkDeviceSize size, VkDeviceSize alignment, GpuTimeline& timeline, GpuStagingRegion& region)
+{
+    while (!Allocate(size, alignment, region))
+    {
+        if (fences_.empty())
+        {
+            fmt::print("staging ring: {} bytes do not fit into {} bytes ring\n", size, size_);
+            return false;
+        }
+        timeline.Wait(fences_.front().timeline_value);
+        Reclaim(timeline.CompletedValue());
+    }
+    return true;
+}
+
+void GpuStagingRing::Flush(const GpuStagingRegion& region)
+{
+    if (atom_size_ == 1)
+    {
+        return;
+    }
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    // region.offset 相对 vk_buffer, flush 的范围相对 vk_memory
+    VkDeviceSize offset = buffer_.allocation.offset + region.offset;
+    range.memory = buffer_.allocation.vk_memory;
+    range.offset = offset / atom_size_ * atom_size_;
+    range.size = std::min(AlignUp(offset + region.size, atom_size_), 
+        buffer_.allocation.offset + buffer_.allocation.size) - range.offset;
+    vkFlushMappedMemoryRanges(vk_device_, 1, &range);
+}
+
+void GpuStagingRing::Retire(uint64_t timeline_value)
+{
+    if (head_ == retired_head_)
+    {
+        return;
+    }
+    fences_.push_back(Fence{ timeline_value, head_ });
+    retired_head_ = head_;
+}
+
+void GpuStagingRing::Reclaim(uint64_t completed_value)
+{
+    while (!fences_.empty() && fences_.front().timeline_value <= completed_value)
+    {
+        tail_ = fences_.front().head;
+        fences_.pop_front();
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vulkan/vulkan.hpp>
+#include "gpu_allocator.h"
+
+class GpuTimeline;
+
+/**
+ * @brief 暂存环中的一段, 直接写 mapped, 再从 vk_buffer 的 offset 处拷贝到目标
+ */
+struct GpuStagingRegion
+{
+    VkBuffer vk_buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;       ///< 相对 vk_buffer 的偏移, 不含 allocation.offset
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+};
+
+/**
+ * @brief 常驻映射的上传暂存环
+ * 启动时申请一块 HOST_VISIBLE buffer, 上传时顺序切分, 
+ * 提交后用 Retire 记录 timeline 值, GPU 越过该值后 Reclaim 回收, 不再每次创建/映射/销毁暂存 buffer
+ */
+class GpuStagingRing final
+{
+public:
+    GpuStagingRing() = default;
+    ~GpuStagingRing();
+
+    GpuStagingRing(const GpuStagingRing&) = delete;
+    GpuStagingRing& operator=(const GpuStagingRing&) = delete;
+
+    bool Init(VkDevice device, GpuAllocator* allocator, VkDeviceSize size, VkDeviceSize non_coherent_atom_size);
+    void UnInit();
+
+    /**
+     * @brief 切分一段空间, 空间不足时返回 false
+     */
+    bool Allocate(VkDeviceSize size, VkDeviceSize alignment, GpuStagingRegion& region);
+
+    /**
+     * @brief 空间不足时等待最早登记的 timeline 值并回收, 直到放得下
+     * 请求超过环大小, 或没有可等待的提交时返回 false
+     */
+    bool AllocateWait(VkDeviceSize size, VkDeviceSize alignment, GpuTimeline& timeline, GpuStagingRegion& region);
+
+    /**
+     * @brief 非 HOST_COHERENT 内存写完后需要 flush
+     */
+    void Flush(const GpuStagingRegion& region);
+
+    /**
+     * @brief 上次 Retire 之后切分的空间都由 timeline_value 这次提交使用
+     */
+    void Retire(uint64_t timeline_value);
+
+    /**
+     * @brief 回收 timeline 值 <= completed_value 的空间
+     */
+    void Reclaim(uint64_t completed_value);
+
+    /**
+     * @brief 最早登记且尚未回收的 timeline 值, 等到它完成才能腾出空间; 没有时返回 0
+     */
+    uint64_t OldestRetiredValue() const { return fences_.empty() ? 0 : fences_.front().timeline_value; }
+
+    VkDeviceSize Size() const { return size_; }
+    VkDeviceSize Used() const { return head_ - tail_; }
+
+private:
+    struct Fence
+    {
+        uint64_t timeline_value = 0;
+        uint64_t head = 0;      ///< 该提交结束位置, 回收后 tail 推进到这里
+    };
+
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+    GpuBuffer buffer_;
+    VkDeviceSize size_ = 0;
+    VkDeviceSize atom_size_ = 1;    ///< 非一致内存 flush 的对齐粒度, 一致内存为 1
+    uint64_t head_ = 0;             ///< 写入位置, 单调递增, 取模得到偏移
+    uint64_t tail_ = 0;             ///< 最早仍在使用的位置
+    uint64_t retired_head_ = 0;
+    std::deque<Fence> fences_;
+};
@@ -0,0 +1,128 @@
+#include "gpu_timeline.h"
+
+#include <fmt/format.h>
+#include "gpu_host_allocator.h"
+
+namespace {
+template <typename T>
+T LoadDeviceFunction(VkDevice device, const char* core_name, const char* khr_name)
+{
+    // 1.2 设备可直接取核心函数, 1.1 设备只能通过 VK_KHR_timeline_semaphore 扩展获取
+    PFN_vkVoidFunction func = vkGetDeviceProcAddr(device, core_name);
+    if (func == nullptr)
+    {
+        func = vkGetDeviceProcAddr(device, khr_name);
+    }
+    return reinterpret_cast<T>(func);
+}
+}
+
+GpuTimeline::~GpuTimeline()
+{
+    UnInit();
+}
+
+bool GpuTimeline::Init(VkDevice device)
+{
+    vk_device_ = device;
+    vk_wait_semaphores_ = LoadDeviceFunction<PFN_vkWaitSemaphores>(device, "vkWaitSemaphores", "vkWaitSemaphoresKHR");
+    vk_get_semaphore_counter_value_ = LoadDeviceFunction<PFN_vkGetSemaphoreCounterValue>(device, 
+        "vkGetSemaphoreCounterValue", "vkGetSemaphoreCounterValueKHR");
+    if (vk_wait_semaphores_ == nullptr || vk_get_semaphore_counter_value_ == nullptr)
+    {
+        fmt::print("timeline semaphore functions are not available\n");
+        return false;
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    VkResult ret = vkCreateSemaphore(vk_device_, &semaphoreInfo, GpuHostCallbacks(), &vk_semaphore_);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateSemaphore (timeline) return error: {}\n", ret);
+        return false;
+    }
+
+    pending_value_ = 0;
+    completed_value_ = 0;
+    return true;
+}
+
+void GpuTimeline::UnInit()
+{
+    if (vk_semaphore_ != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(vk_device_, vk_semaphore_, GpuHostCallbacks());
+        vk_semaphore_ = VK_NULL_HANDLE;
+    }
+    vk_device_ = VK_NULL_HANDLE;
+}
+
+uint64_t GpuTimeline::NextValue()
+{
+    return ++pending_value_;
+}
+
+uint64_t GpuTimeline::PendingValue() const
+{
+    return pending_value_;
+}
+
+uint64_t GpuTimeline::CompletedValue()
+{
+    uint64_t value = 0;
+    if (vk_get_semaphore_counter_value_(vk_device_, vk_semaphore_, &value) != VK_SUCCESS)
+    {
+        return completed_value_;
+    }
+
+    // 多线程查询时保证缓存单调递增
+    uint64_t cached = completed_value_.load();
+    while (cached < value && !completed_value_.compare_exchange_weak(cached, value))
+    {
+    }
+    return value;
+}
+
+bool GpuTimeline::IsComplete(uint64_t value)
+{
+    // 先查缓存, 避免每次都调用驱动
+    if (value <= completed_value_)
+    {
+        return true;
+    }
+    return value <= CompletedValue();
+}
+
+bool GpuTimeline::Wait(uint64_t value, uint64_t timeout)
+{
+    if (value <= completed_value_)
+    {
+        return true;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &vk_semaphore_;
+    waitInfo.pValues = &value;
+
+    VkResult ret = vk_wait_semaphores_(vk_device_, &waitInfo, timeout);
+    if (ret != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    uint64_t cached = completed_value_.load();
+    while (cached < value && !completed_value_.compare_exchange_weak(cached, value))
+    {
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+
+/**
+ * @brief 基于 timeline semaphore 的队列进度计数器
+ * 每个队列一个单调递增的计数, 每次提交 signal 一个新的值,
+ * CPU 通过等待 "第 N 个值" 代替 fence 的等待/重置
+ */
+class GpuTimeline final
+{
+public:
+    GpuTimeline() = default;
+    ~GpuTimeline();
+
+    bool Init(VkDevice device);
+    void UnInit();
+
+    /**
+     * @brief 预留下一次提交需要 signal 的值
+     */
+    uint64_t NextValue();
+
+    /**
+     * @brief 最近一次预留的值, 即最后一次提交完成后计数会到达的值
+     */
+    uint64_t PendingValue() const;
+
+    /**
+     * @brief GPU 已经完成到的值, 用于资源回收判断
+     */
+    uint64_t CompletedValue();
+
+    bool IsComplete(uint64_t value);
+    bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+public:
+    VkSemaphore vk_semaphore_ = VK_NULL_HANDLE;   ///< timeline 信号量
+
+private:
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    PFN_vkWaitSemaphores vk_wait_semaphores_ = nullptr;
+    PFN_vkGetSemaphoreCounterValue vk_get_semaphore_counter_value_ = nullptr;
+
+    std::atomic<uint64_t> pending_value_ = 0;
+    std::atomic<uint64_t> completed_value_ = 0;    ///< 查询结果缓存, 只增不减
+};
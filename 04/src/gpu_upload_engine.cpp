@@ -0,0 +1,266 @@
+#include "gpu_upload_engine.h"
+
+#include <cstring>
+#include <fmt/format.h>
+#include "gpu_host_allocator.h"
+#include "gpu_resource.h"
+
+GpuUploadEngine::~GpuUploadEngine()
+{
+    UnInit();
+}
+
+bool GpuUploadEngine::Init(GpuResource* resource, VkDeviceSize staging_size)
+{
+    resource_ = resource;
+    vk_device_ = resource->vk_device_;
+    graphics_family_ = static_cast<uint32_t>(resource->vk_graphics_family_);
+    dedicated_queue_ = resource->vk_transfer_family_ != resource->vk_graphics_family_;
+    queue_family_ = static_cast<uint32_t>(resource->vk_transfer_family_);
+    vk_queue_ = resource->vk_transfer_queue_;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queue_family_;
+
+    VkResult ret = vkCreateCommandPool(vk_device_, &poolInfo, GpuHostCallbacks(), &vk_commandpool_);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkCreateCommandPool (upload) return error: {}\n", ret);
+        return false;
+    }
+
+    if (!timeline_.Init(vk_device_))
+    {
+        return false;
+    }
+
+    if (!staging_ring_.Init(vk_device_, &resource->allocator_, staging_size, resource->GetLimits().nonCoherentAtomSize))
+    {
+        return false;
+    }
+
+    fmt::print("upload engine: {} queue family {}\n", dedicated_queue_ ? "dedicated transfer" : "graphics", queue_family_);
+    return true;
+}
+
+void GpuUploadEngine::UnInit()
+{
+    if (vk_device_ == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    // 调用方已等待设备空闲
+    staging_ring_.UnInit();
+    inflight_commands_.clear();
+    pending_copies_.clear();
+    acquire_copies_.clear();
+    if (vk_commandpool_ != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(vk_device_, vk_commandpool_, GpuHostCallbacks());
+        vk_commandpool_ = VK_NULL_HANDLE;
+    }
+    timeline_.UnInit();
+    vk_device_ = VK_NULL_HANDLE;
+    resource_ = nullptr;
+}
+
+uint64_t GpuUploadEngine::UploadBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dst_offset,
+    VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    GpuStagingRegion region;
+    while (true)
+    {
+        staging_ring_.Reclaim(timeline_.CompletedValue());
+        if (staging_ring_.Allocate(size, 4, region))
+        {
+            break;
+        }
+
+        // 空间都被排队中的拷贝占用时要等渲染线程 Submit, 直接失败由调用方稍后重试
+        uint64_t wait_value = staging_ring_.OldestRetiredValue();
+        if (wait_value == 0 || size > staging_ring_.Size())
+        {
+            fmt::print("upload engine: {} bytes do not fit into staging ring\n", size);
+            return 0;
+        }
+
+        // 等待 GPU 时不持有锁, 渲染线程的 Submit 和 RecordAcquireBarriers 不受影响
+        lock.unlock();
+        timeline_.Wait(wait_value);
+        lock.lock();
+    }
+    memcpy(region.mapped, data, static_cast<size_t>(size));
+    staging_ring_.Flush(region);
+
+    BufferCopy copy;
+    copy.vk_src = region.vk_buffer;
+    copy.vk_dst = dst;
+    copy.region.srcOffset = region.offset;
+    copy.region.dstOffset = dst_offset;
+    copy.region.size = size;
+    copy.dst_stage = dst_stage;
+    copy.dst_access = dst_access;
+    pending_copies_.push_back(copy);
+
+    // 排队中的拷贝都由下一次 Submit 提交
+    return timeline_.PendingValue() + 1;
+}
+
+uint64_t GpuUploadEngine::Submit()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_copies_.empty())
+    {
+        return 0;
+    }
+
+    VkCommandBuffer commandBuffer = _AcquireCommandBuffer();
+    if (commandBuffer == VK_NULL_HANDLE)
+    {
+        return 0;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    for (const auto& copy : pending_copies_)
+    {
+        vkCmdCopyBuffer(commandBuffer, copy.vk_src, copy.vk_dst, 1, &copy.region);
+    }
+
+    if (dedicated_queue_)
+    {
+        // 释放所有权, 图形队列录制对应的 acquire 屏障后才能使用
+        std::vector<VkBufferMemoryBarrier> barriers;
+        barriers.reserve(pending_copies_.size());
+        for (const auto& copy : pending_copies_)
+        {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = queue_family_;
+            barrier.dstQueueFamilyIndex = graphics_family_;
+            barrier.buffer = copy.vk_dst;
+            barrier.offset = copy.region.dstOffset;
+            barrier.size = copy.region.size;
+            barriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+    else {
+        // 同一队列, 屏障按提交顺序对之后的图形提交生效
+        VkPipelineStageFlags dst_stage = 0;
+        VkAccessFlags dst_access = 0;
+        for (const auto& copy : pending_copies_)
+        {
+            dst_stage |= copy.dst_stage;
+            dst_access |= copy.dst_access;
+        }
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dst_access;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    vkEndCommandBuffer(commandBuffer);
+
+    uint64_t signal_value = timeline_.NextValue();
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signal_value;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timeline_.vk_semaphore_;
+
+    VkResult ret = vkQueueSubmit(vk_queue_, 1, &submitInfo, VK_NULL_HANDLE);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkQueueSubmit (upload) return error: {}\n", ret);
+        return 0;
+    }
+
+    inflight_commands_.push_back(InflightCommand{ signal_value, commandBuffer });
+    staging_ring_.Retire(signal_value);
+    if (dedicated_queue_)
+    {
+        acquire_copies_.insert(acquire_copies_.end(), pending_copies_.begin(), pending_copies_.end());
+        acquire_value_ = signal_value;
+    }
+    pending_copies_.clear();
+    return signal_value;
+}
+
+uint64_t GpuUploadEngine::RecordAcquireBarriers(VkCommandBuffer commandBuffer, VkPipelineStageFlags& wait_stage)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    wait_stage = 0;
+    if (acquire_copies_.empty())
+    {
+        return 0;
+    }
+
+    std::vector<VkBufferMemoryBarrier> barriers;
+    barriers.reserve(acquire_copies_.size());
+    for (const auto& copy : acquire_copies_)
+    {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = copy.dst_access;
+        barrier.srcQueueFamilyIndex = queue_family_;
+        barrier.dstQueueFamilyIndex = graphics_family_;
+        barrier.buffer = copy.vk_dst;
+        barrier.offset = copy.region.dstOffset;
+        barrier.size = copy.region.size;
+        barriers.push_back(barrier);
+        wait_stage |= copy.dst_stage;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, wait_stage, 0,
+        0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+    acquire_copies_.clear();
+    return acquire_value_;
+}
+
+VkCommandBuffer GpuUploadEngine::_AcquireCommandBuffer()
+{
+    // 复用已经执行完的命令缓冲
+    if (!inflight_commands_.empty() && timeline_.IsComplete(inflight_commands_.front().timeline_value))
+    {
+        VkCommandBuffer commandBuffer = inflight_commands_.front().vk_commandbuffer;
+        inflight_commands_.pop_front();
+        vkResetCommandBuffer(commandBuffer, 0);
+        return commandBuffer;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = vk_commandpool_;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkResult ret = vkAllocateCommandBuffers(vk_device_, &allocInfo, &commandBuffer);
+    if (ret != VK_SUCCESS)
+    {
+        fmt::print("vkAllocateCommandBuffers (upload) return error: {}\n", ret);
+        return VK_NULL_HANDLE;
+    }
+    return commandBuffer;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "gpu_staging_ring.h"
+#include "gpu_timeline.h"
+
+class GpuResource;
+
+/**
+ * @brief 异步上传引擎
+ * 任意线程调用 UploadBuffer 把数据写进暂存环并排队, 渲染线程每帧 Submit 一次, 把排队的拷贝合并成一次提交.
+ * 有独立传输队列时在传输队列上执行, 通过 release/acquire 屏障把 buffer 所有权交给图形队列,
+ * 图形队列提交时等待传输 timeline. 没有时退回图形队列, 用内存屏障代替所有权转移.
+ * 调用方拿到 timeline 值 (ticket), 通过 IsComplete/Wait 查询, 不阻塞
+ */
+class GpuUploadEngine final
+{
+public:
+    GpuUploadEngine() = default;
+    ~GpuUploadEngine();
+
+    GpuUploadEngine(const GpuUploadEngine&) = delete;
+    GpuUploadEngine& operator=(const GpuUploadEngine&) = delete;
+
+    bool Init(GpuResource* resource, VkDeviceSize staging_size);
+    void UnInit();
+
+    /**
+     * @brief 排队一次 buffer 上传, 线程安全
+     * 暂存环满时不持锁等待已提交的上传完成; 空间被尚未提交的拷贝占满时返回 0, 调用方在下一帧后重试
+     * @param dst_stage dst_access 目标 buffer 之后在图形队列上的使用方式
+     * @return ticket, 传输 timeline 到达该值后上传完成; 失败返回 0
+     */
+    uint64_t UploadBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dst_offset,
+        VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+
+    /**
+     * @brief 提交排队的拷贝, 只能在渲染线程调用
+     * @return 本次提交 signal 的值, 没有排队的拷贝时返回 0
+     */
+    uint64_t Submit();
+
+    /**
+     * @brief 在图形命令缓冲开头录制 acquire 屏障, 只能在渲染线程调用
+     * @param wait_stage 返回图形队列提交需要等待传输 timeline 的阶段
+     * @return 需要等待的传输 timeline 值, 不需要等待时返回 0
+     */
+    uint64_t RecordAcquireBarriers(VkCommandBuffer commandBuffer, VkPipelineStageFlags& wait_stage);
+
+    bool IsComplete(uint64_t ticket) { return timeline_.IsComplete(ticket); }
+
+    /**
+     * @brief 等待上传完成, 不要在渲染线程 Submit 之前等待本帧排队的 ticket
+     */
+    bool Wait(uint64_t ticket) { return timeline_.Wait(ticket); }
+
+    bool HasDedicatedQueue() const { return dedicated_queue_; }
+
+public:
+    GpuTimeline timeline_;  ///< 上传进度计数
+
+private:
+    struct BufferCopy
+    {
+        VkBuffer vk_src = VK_NULL_HANDLE;
+        VkBuffer vk_dst = VK_NULL_HANDLE;
+        VkBufferCopy region{};
+        VkPipelineStageFlags dst_stage = 0;
+        VkAccessFlags dst_access = 0;
+    };
+
+    struct InflightCommand
+    {
+        uint64_t timeline_value = 0;
+        VkCommandBuffer vk_commandbuffer = VK_NULL_HANDLE;
+    };
+
+    VkCommandBuffer _AcquireCommandBuffer();
+
+private:
+    GpuResource* resource_ = nullptr;
+    VkDevice vk_device_ = VK_NULL_HANDLE;
+    VkQueue vk_queue_ = VK_NULL_HANDLE;
+    uint32_t queue_family_ = 0;
+    uint32_t graphics_family_ = 0;
+    bool dedicated_queue_ = false;
+    VkCommandPool vk_commandpool_ = VK_NULL_HANDLE;
+
+    std::mutex mutex_;
+    GpuStagingRing staging_ring_;
+    std::vector<BufferCopy> pending_copies_;    ///< 等待 Submit
+    std::vector<BufferCopy> acquire_copies_;    ///< 已在传输队列释放, 等待图形队列 acquire
+    uint64_t acquire_value_ = 0;
+    std::deque<InflightCommand> inflight_commands_;
+};
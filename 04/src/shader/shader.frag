@@ -1,9 +1,12 @@
-#version 450
-
-layout(location = 0) in vec3 fragColor;
-
-layout(location = 0) out vec4 outColor;
-
-void main() {
-    outColor = vec4(fragColor, 1.0);
+#version 450
+
+// 特化常量, 管线编译时由 GpuProgram 代入
+layout(constant_id = 0) const float kBrightness = 1.0;
+
+layout(location = 0) in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(fragColor * kBrightness, 1.0);
 }
\ No newline at end of file
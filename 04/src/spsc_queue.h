@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/**
+ * @brief 单生产者单消费者无锁环形队列
+ * 只允许一个线程 TryPush, 另一个线程 TryPop, 容量需为 2 的幂
+ */
+template <typename T, size_t Capacity>
+class SpscQueue final
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be power of two");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief 入队, 队列满时返回 false
+     */
+    bool TryPush(const T& value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == Capacity)
+        {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == Capacity)
+            {
+                return false;
+            }
+        }
+        slots_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 出队, 队列空时返回 false
+     */
+    bool TryPop(T& value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_)
+        {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+            {
+                return false;
+            }
+        }
+        value = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    // 生产者和消费者的索引分开放在不同缓存行, 避免伪共享
+    alignas(kCacheLine) std::atomic<size_t> head_ = 0;
+    size_t tail_cache_ = 0;                 ///< 消费者缓存的 tail
+    alignas(kCacheLine) std::atomic<size_t> tail_ = 0;
+    size_t head_cache_ = 0;                 ///< 生产者缓存的 head
+    alignas(kCacheLine) std::array<T, Capacity> slots_{};
+};
@@ -1,284 +1,175 @@
-#include "triangle_shader.h"
-
-#include <fmt/format.h>
-
-TriangleShader::TriangleShader(GpuResource* device)
-{
-	vk_resource_ = device;
-}
-
-TriangleShader::~TriangleShader()
-{
-	if (vk_graphics_pipeline_ != VK_NULL_HANDLE)
-	{
-		vkDestroyPipeline(vk_resource_->vk_device_, vk_graphics_pipeline_, nullptr);
-		vk_graphics_pipeline_ = VK_NULL_HANDLE;
-	}
-
-	if (vk_render_pass_ != VK_NULL_HANDLE)
-	{
-		vkDestroyRenderPass(vk_resource_->vk_device_, vk_render_pass_, nullptr);
-		vk_render_pass_ = VK_NULL_HANDLE;
-	}
-
-	if (vk_pipeline_layout_ == VK_NULL_HANDLE)
-	{
-		vkDestroyPipelineLayout(vk_resource_->vk_device_, vk_pipeline_layout_, nullptr);
-		vk_pipeline_layout_ = VK_NULL_HANDLE;
-	}
-}
-
-bool TriangleShader::Init(const ShaderParam& param)
-{
-	std::optional<VkShaderModule> vertex_module = _CreateShaderModule(param.vertex_shader);
-	std::optional<VkShaderModule> pixel_module = _CreateShaderModule(param.pixel_shader);
-
-	bool result = false;
-	if (!vertex_module || !pixel_module)
-	{
-		goto DESTROY_SHADER_RESOURCE;
-	}
-
-	if (!_CreateRenderPass())
-	{
-		goto DESTROY_SHADER_RESOURCE;
-	}
-
-	result = _CreatePipeline(vertex_module.value(), pixel_module.value(), param.viewport);
-
-DESTROY_SHADER_RESOURCE:
-	if (vertex_module)
-	{
-		_DestroyShaderModule(vertex_module.value());
-	}
-	
-	if (pixel_module)
-	{
-		_DestroyShaderModule(pixel_module.value());
-	}
-	return result;
-}
-
-std::optional<VkShaderModule> TriangleShader::_CreateShaderModule(const std::vector<char>& shader)
-{
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = shader.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(shader.data());
-
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(vk_resource_->vk_device_, &createInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
-	{
-		return {};
-	}
-	return shaderModule;
-}
-
-void TriangleShader::_DestroyShaderModule(VkShaderModule shader)
-{
-	vkDestroyShaderModule(vk_resource_->vk_device_, shader, nullptr);
-}
-
-bool TriangleShader::_CreatePipeline(VkShaderModule vertex_shader, VkShaderModule pixel_shader, 
-									const VkExtent2D& image_exent)
-{
-	// 创建着色器
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertex_shader;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = pixel_shader;
-	fragShaderStageInfo.pName = "main";
-
-	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
-	shaderStages.push_back(vertShaderStageInfo);
-	shaderStages.push_back(fragShaderStageInfo);
-
-	// 创建顶点输入描述
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexAttributeDescriptionCount = 0;
-	vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-	vertexInputInfo.vertexBindingDescriptionCount = 0;
-	vertexInputInfo.pVertexBindingDescriptions = nullptr;
-
-	// 创建图元描述
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	// 视口
-	VkViewport viewport{};
-	viewport.height = static_cast<float>(image_exent.height);
-	viewport.width = static_cast<float>(image_exent.width);
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	// 裁剪区域
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = image_exent;
-
-	// 创建可变的管线状态
-	std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-	//创建光栅化
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // 开启背面提出模式
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;	// 顺时针
-	rasterizer.depthBiasEnable = VK_FALSE;
-	rasterizer.depthBiasConstantFactor = 0.0f;
-	rasterizer.depthBiasClamp = 0.0f;
-	rasterizer.depthBiasSlopeFactor = 0.0f;
-
-	// 多重采样
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	//multisampling.minSampleShading = 1.0f;
-	//multisampling.pSampleMask = nullptr;
-	//multisampling.alphaToCoverageEnable = VK_FALSE;
-	//multisampling.alphaToOneEnable = VK_FALSE;
-
-	// 深度测试 和 模板测试
-
-	// 混合
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.blendEnable = VK_FALSE; // 禁用颜色混合
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	//colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-	//colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
-	//colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-	//colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	//colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	//colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f;
-	colorBlending.blendConstants[1] = 0.0f;
-	colorBlending.blendConstants[2] = 0.0f;
-	colorBlending.blendConstants[3] = 0.0f;
-
-	// 创建空的uniform
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pSetLayouts = nullptr;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = nullptr;
-	VkResult ret = vkCreatePipelineLayout(vk_resource_->vk_device_, &pipelineLayoutInfo, nullptr, &vk_pipeline_layout_);
-	if (ret != VK_SUCCESS)
-	{
-		fmt::print("vkCreatePipelineLayout return error: {}\n", ret);
-		return false;
-	}
-
-	// 创建图形管线
-	VkGraphicsPipelineCreateInfo pipelineInfo;
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.pNext = nullptr;
-	pipelineInfo.flags = 0;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages.data();
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.pTessellationState = nullptr;
-	pipelineInfo.layout = vk_pipeline_layout_;
-	pipelineInfo.renderPass = vk_render_pass_;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-	ret = vkCreateGraphicsPipelines(vk_resource_->vk_device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &vk_graphics_pipeline_);
-	if (ret != VK_SUCCESS)
-	{
-		fmt::print("vkCreateGraphicsPipelines return error: {} \n", ret);
-		return false;
-	}
-
-	return true;
-}
-
-bool TriangleShader::_CreateRenderPass()
-{
-	VkAttachmentDescription colorAttachment{};
-	colorAttachment.format = vk_resource_->vk_swapchain_image_format;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colorAttachmentRef{};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	
-	VkSubpassDescription subpass{};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
-
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkRenderPassCreateInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colorAttachment;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-	VkResult ret = vkCreateRenderPass(vk_resource_->vk_device_, &renderPassInfo, nullptr, &vk_render_pass_);
-	if (ret != VK_SUCCESS)
-	{
-		fmt::print("vkCreateRenderPass return error: {}\n", ret);
-		return false;
-	}
-	
-	return true;
-}
\ No newline at end of file
+#include "triangle_shader.h"
+
+#include <fmt/format.h>
+#include "gpu_host_allocator.h"
+
+TriangleShader::TriangleShader(GpuResource* device)
+{
+	vk_resource_ = device;
+}
+
+TriangleShader::~TriangleShader()
+{
+	// 监视线程已停止, 这里只需等待编译结束后释放着色器模块引用
+	// 管线, 渲染通道和布局由管线库销毁
+	for (auto& version : pending_)
+	{
+		vk_resource_->pipeline_compiler_.Wait(version.pipeline);
+		_ReleaseVersion(version);
+	}
+	pending_.clear();
+
+	vk_resource_->pipeline_compiler_.Wait(current_.pipeline);
+	_ReleaseVersion(current_);
+}
+
+bool TriangleShader::Init(const ShaderParam& param)
+{
+	param_ = param;
+
+	// 渲染通道只依赖目标格式和布局, 多个着色器共用. 动态渲染不需要渲染通道
+	if (!vk_resource_->UseDynamicRendering())
+	{
+		GpuRenderPassDesc render_pass_desc;
+		render_pass_desc.color_format = vk_resource_->vk_swapchain_image_format;
+		render_pass_desc.final_layout = vk_resource_->vk_target_layout_;
+		vk_render_pass_ = vk_resource_->pipeline_library_.GetRenderPass(render_pass_desc);
+		if (vk_render_pass_ == VK_NULL_HANDLE)
+		{
+			return false;
+		}
+	}
+
+	return _CreatePipeline(current_, false);
+}
+
+void TriangleShader::OnShaderChanged(const std::string& path)
+{
+	if (path != param_.vertex_shader && path != param_.pixel_shader)
+	{
+		return;
+	}
+
+	// 加载和提交编译都在调用线程完成, 只在入队时加锁
+	PipelineVersion version;
+	if (!_CreatePipeline(version, true))
+	{
+		fmt::print("reload {} failed, keep the current pipeline\n", path);
+		_ReleaseVersion(version);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(reload_mutex_);
+	pending_.push_back(std::move(version));
+}
+
+void TriangleShader::Update()
+{
+	std::lock_guard<std::mutex> lock(reload_mutex_);
+	// 当前管线编译完成后才能被换下, 否则无法释放
+	while (!pending_.empty() && current_.pipeline.Status() != GpuPipelineStatus::kPending)
+	{
+		PipelineVersion& version = pending_.front();
+		GpuPipelineStatus status = version.pipeline.Status();
+		if (status == GpuPipelineStatus::kPending)
+		{
+			// 还在编译, 继续使用当前管线
+			break;
+		}
+
+		if (status == GpuPipelineStatus::kReady)
+		{
+			std::swap(current_, version);
+		}
+		else {
+			fmt::print("reloaded pipeline failed to compile, keep the current pipeline\n");
+		}
+		// 被换下的版本可能仍被已提交的帧使用, 管线在 GPU 用完后释放
+		_ReleaseVersion(version);
+		pending_.erase(pending_.begin());
+	}
+}
+
+bool TriangleShader::_CreatePipeline(PipelineVersion& version, bool from_files)
+{
+	// 相同内容的着色器只创建一次模块
+	version.vertex_module = _LoadModule(param_.vertex_embedded, param_.vertex_shader, from_files);
+	version.pixel_module = _LoadModule(param_.pixel_embedded, param_.pixel_shader, from_files);
+	if (!version.vertex_module || !version.pixel_module)
+	{
+		return false;
+	}
+
+	// 布局和顶点输入由两个阶段的接口生成, 热重载修改了接口时随新版本一起切换
+	GpuShaderReflection reflection = *version.vertex_module->reflection;
+	if (!reflection.Merge(*version.pixel_module->reflection))
+	{
+		return false;
+	}
+	version.vk_pipeline_layout = vk_resource_->pipeline_library_.GetPipelineLayout(reflection);
+	if (version.vk_pipeline_layout == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	// 相同状态的管线已存在时直接复用, 否则提交到编译线程, 完成前只清屏
+	GraphicsPipelineDesc desc;
+	desc.vertex_shader = version.vertex_module->vk_module;
+	desc.fragment_shader = version.pixel_module->vk_module;
+	desc.vertex_hash = version.vertex_module->hash;
+	desc.fragment_hash = version.pixel_module->hash;
+	desc.layout = version.vk_pipeline_layout;
+	desc.render_pass = vk_render_pass_;
+	desc.subpass = 0;
+	desc.color_format = vk_resource_->vk_swapchain_image_format;
+	desc.state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	desc.state.cull_mode = VK_CULL_MODE_BACK_BIT;	// 开启背面剔除
+	desc.state.front_face = VK_FRONT_FACE_CLOCKWISE;	// 顺时针
+	if (!reflection.BuildVertexLayout(desc.state.vertex_layout))
+	{
+		return false;
+	}
+	desc.vertex_constants = param_.vertex_constants;
+	desc.fragment_constants = param_.pixel_constants;
+	version.pipeline = vk_resource_->pipeline_library_.GetPipeline(desc);
+	return version.pipeline.Status() != GpuPipelineStatus::kFailed;
+}
+
+std::optional<GpuShaderModule> TriangleShader::_LoadModule(const GpuEmbeddedShader* embedded, const std::string& path, bool from_files)
+{
+	if (embedded != nullptr && !from_files)
+	{
+		return vk_resource_->shader_cache_.Acquire(*embedded);
+	}
+	return vk_resource_->shader_cache_.Load(path);
+}
+
+void TriangleShader::_ReleaseVersion(PipelineVersion& version)
+{
+	// 管线创建后驱动不再需要着色器模块, 可以立即释放引用
+	if (version.vertex_module)
+	{
+		vk_resource_->shader_cache_.Release(version.vertex_module.value());
+		version.vertex_module.reset();
+	}
+
+	if (version.pixel_module)
+	{
+		vk_resource_->shader_cache_.Release(version.pixel_module.value());
+		version.pixel_module.reset();
+	}
+
+	if (version.pipeline.IsValid())
+	{
+		VkPipeline pipeline = vk_resource_->pipeline_library_.ReleasePipeline(version.pipeline);
+		if (pipeline != VK_NULL_HANDLE)
+		{
+			VkDevice device = vk_resource_->vk_device_;
+			uint64_t retire_value = vk_resource_->graphics_timeline_.PendingValue();
+			vk_resource_->deletion_queue_.Push(retire_value, [device, pipeline]() {
+				vkDestroyPipeline(device, pipeline, GpuHostCallbacks());
+			});
+		}
+		version.pipeline = GpuPipelineHandle();
+	}
+}
@@ -1,36 +1,78 @@
-#pragma once
-
-#include <vulkan/vulkan.hpp>
-#include "gpu_resource.h"
-
-class TriangleShader
-{
-public:
-	struct ShaderParam
-	{
-		std::vector<char> vertex_shader;
-		std::vector<char> pixel_shader;
-		VkExtent2D viewport;
-	};
-
-public:
-	TriangleShader(GpuResource* device);
-	~TriangleShader();
-
-	bool Init(const ShaderParam& param);
-
-private:
-	std::optional<VkShaderModule> _CreateShaderModule(const std::vector<char>& shader);
-	void _DestroyShaderModule(VkShaderModule shader);
-	bool _CreatePipeline(VkShaderModule vertex_shader, VkShaderModule pixel_shader, 
-						const VkExtent2D& image_exent);
-	bool _CreateRenderPass();
-
-public:
-	VkRenderPass vk_render_pass_ = VK_NULL_HANDLE;
-	VkPipeline vk_graphics_pipeline_ = VK_NULL_HANDLE;
-
-private:
-	GpuResource* vk_resource_ = nullptr;
-	VkPipelineLayout vk_pipeline_layout_ = VK_NULL_HANDLE;
-};
\ No newline at end of file
+#pragma once
+
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+#include "gpu_resource.h"
+
+class TriangleShader
+{
+public:
+	struct ShaderParam
+	{
+		std::string vertex_shader;	///< SPIR-V 文件路径, 没有嵌入代码或热重载时读取
+		std::string pixel_shader;
+		const GpuEmbeddedShader* vertex_embedded = nullptr;	///< 构建时嵌入的代码, 不为空时初始化不读文件
+		const GpuEmbeddedShader* pixel_embedded = nullptr;
+		GpuSpecialization vertex_constants;	///< 着色器变体 (质量等级, 光源数量等), 编译期确定
+		GpuSpecialization pixel_constants;
+	};
+
+public:
+	TriangleShader(GpuResource* device);
+	~TriangleShader();
+
+	/**
+	 * @brief 从管线库取得渲染通道, 布局和管线, 新管线提交到编译线程
+	 */
+	bool Init(const ShaderParam& param);
+
+	/**
+	 * @brief 管线编译完成前返回空, 调用方跳过绘制
+	 */
+	VkPipeline GetPipeline() const { return current_.pipeline.Get(); }
+
+	/**
+	 * @brief 当前管线的布局, 由着色器反射生成, 绑定描述符和推送常量时使用
+	 */
+	VkPipelineLayout GetPipelineLayout() const { return current_.vk_pipeline_layout; }
+
+	/**
+	 * @brief 着色器文件变化, 在后台重新加载并编译, 任意线程调用
+	 */
+	void OnShaderChanged(const std::string& path);
+
+	/**
+	 * @brief 帧开始时在渲染线程调用, 新管线编译完成后切换, 旧管线延迟释放. 不会等待编译
+	 */
+	void Update();
+
+private:
+	/**
+	 * @brief 一组着色器模块和用它们编译的管线
+	 */
+	struct PipelineVersion
+	{
+		std::optional<GpuShaderModule> vertex_module;
+		std::optional<GpuShaderModule> pixel_module;
+		VkPipelineLayout vk_pipeline_layout = VK_NULL_HANDLE;	///< 管线库所有
+		GpuPipelineHandle pipeline;
+	};
+
+	/**
+	 * @param from_files 热重载时忽略嵌入的代码, 读取重新编译的文件
+	 */
+	bool _CreatePipeline(PipelineVersion& version, bool from_files);
+	std::optional<GpuShaderModule> _LoadModule(const GpuEmbeddedShader* embedded, const std::string& path, bool from_files);
+	void _ReleaseVersion(PipelineVersion& version);
+
+public:
+	VkRenderPass vk_render_pass_ = VK_NULL_HANDLE;	///< 管线库所有, 动态渲染时为空
+
+private:
+	GpuResource* vk_resource_ = nullptr;
+	ShaderParam param_;
+	PipelineVersion current_;	///< 渲染线程使用, 管线归管线库所有
+
+	std::mutex reload_mutex_;
+	std::vector<PipelineVersion> pending_;	///< 重新加载后等待编译完成的版本, 按提交顺序切换
+};